@@ -0,0 +1,22 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace Bench {
+
+// the fastest of `runs` calls of `body`, in milliseconds
+template <typename Body>
+double best_of(const int runs, Body body)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int i = 0; i < runs; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+}
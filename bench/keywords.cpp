@@ -0,0 +1,77 @@
+// Times keyword classification over an identifier-heavy word list: keyword_type()'s perfect hash against comparing
+// each word with every keyword in turn, the way the tokenizer used to.
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/tokenization.hpp"
+#include "./bench.hpp"
+
+namespace {
+
+std::optional<TokenType> sequential_keyword_type(const std::string_view word)
+{
+    for (const Keyword& keyword : Keywords) {
+        if (word == keyword.spelling) {
+            return keyword.type;
+        }
+    }
+    return {};
+}
+
+// one word in eight is a keyword, the rest are identifiers of 1 to 12 letters
+std::vector<std::string> make_words(const size_t count)
+{
+    std::mt19937_64 random(2024);
+    std::uniform_int_distribution<size_t> length(1, 12);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> words;
+    words.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (i % 8 == 0) {
+            words.emplace_back(Keywords[random() % Keywords.size()].spelling);
+            continue;
+        }
+        std::string word(length(random), ' ');
+        for (char& c : word) {
+            c = static_cast<char>(letter(random));
+        }
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+template <typename Classify>
+double time_classify(const std::vector<std::string>& words, Classify classify, size_t& keywords)
+{
+    return Bench::best_of(5, [&] {
+        keywords = 0;
+        for (const std::string& word : words) {
+            keywords += classify(word).has_value();
+        }
+    });
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const size_t count = argc > 1 ? std::stoul(argv[1]) : 2'800'000;
+    const std::vector<std::string> words = make_words(count);
+
+    size_t hashed = 0;
+    size_t compared = 0;
+    const double hash_ms = time_classify(words, keyword_type, hashed);
+    const double sequential_ms = time_classify(words, sequential_keyword_type, compared);
+    if (hashed != compared) {
+        std::cerr << "the two disagree, " << hashed << " keywords against " << compared << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << words.size() << " words, " << hashed << " keywords, best of 5" << std::endl;
+    std::cout << "perfect hash         " << hash_ms << " ms" << std::endl;
+    std::cout << "sequential compares  " << sequential_ms << " ms" << std::endl;
+    return EXIT_SUCCESS;
+}
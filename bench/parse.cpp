@@ -0,0 +1,85 @@
+// Times tokenizing and parsing a generated program of a million top level statements, every kind of statement the
+// parser dispatches on taking its turn.
+#include <iostream>
+#include <string>
+
+#include "../src/arena.hpp"
+#include "../src/ast.hpp"
+#include "../src/parser.hpp"
+#include "./bench.hpp"
+
+namespace {
+
+std::string make_program(const size_t statements)
+{
+    std::string source;
+    for (size_t i = 0; i < statements; i++) {
+        const std::string name = "v" + std::to_string(i % 1000);
+        switch (i % 6) {
+        case 0:
+            source += "let mut " + name + " = " + std::to_string(i) + " * (3 + " + name + ") / 7;\n";
+            break;
+        case 1:
+            source += name + " = " + name + " - 1;\n";
+            break;
+        case 2:
+            source += "print(\"" + name + " is \" + " + name + " + \"\\n\");\n";
+            break;
+        case 3:
+            source += "if " + name + " - 2 { " + name + " = 2; } else { print(\"two\"); }\n";
+            break;
+        case 4:
+            source += "while " + name + " { " + name + " = " + name + " - 1; }\n";
+            break;
+        case 5:
+            source += "{ let " + name + " = \"" + name + "\"; }\n";
+            break;
+        }
+    }
+    source += "exit(0);\n";
+    return source;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const size_t statements = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+    const std::string source = make_program(statements);
+    const SourceMap source_map(source);
+
+    size_t tokens = 0;
+    const double tokenize_ms = Bench::best_of(5, [&] {
+        Diagnostics diagnostics(&source_map);
+        Interner interner;
+        Tokenizer tokenizer(source, &diagnostics, &interner);
+        tokens = 0;
+        while (tokenizer.next().has_value()) {
+            tokens++;
+        }
+    });
+
+    size_t nodes = 0;
+    bool failed = false;
+    const double parse_ms = Bench::best_of(5, [&] {
+        Diagnostics diagnostics(&source_map);
+        Interner interner;
+        Tokenizer tokenizer(source, &diagnostics, &interner);
+        TokenStream stream(&tokenizer);
+        ArenaAllocator allocator;
+        Node::Ast ast(&allocator);
+        Parser(&stream, &ast, &diagnostics).parse();
+        nodes = ast.size();
+        failed = diagnostics.has_errors();
+    });
+    if (failed) {
+        std::cerr << "the generated program does not parse" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << statements << " statements, " << source.size() / 1024 / 1024 << " MB, " << tokens << " tokens, "
+              << nodes << " nodes, best of 5" << std::endl;
+    std::cout << "tokenize          " << tokenize_ms << " ms" << std::endl;
+    std::cout << "tokenize + parse  " << parse_ms << " ms" << std::endl;
+    return EXIT_SUCCESS;
+}
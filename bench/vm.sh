@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+# Times `helium vm` against the executables helium makes at -O0 and -O1, for every program in bench/.
+# Builds helium as Release into the directory given as the first argument, ./build-bench by default.
+set -euo pipefail
+
+BUILD_DIR=${1:-./build-bench}
+BENCH_DIR=$(dirname "$0")
+
+cmake -S "$BENCH_DIR/.." -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release >/dev/null
+cmake --build "$BUILD_DIR" --target helium >/dev/null
+HELIUM="$BUILD_DIR/helium"
+
+OUT_DIR=$(mktemp -d)
+trap 'rm -rf "$OUT_DIR"' EXIT
+
+# the best wall time of three runs, in seconds. output is thrown away and the exit code, which the programs compute,
+# is ignored.
+best() {
+    local best="" time
+    for _ in 1 2 3; do
+        time=$( { TIMEFORMAT=%R; time "$@" >/dev/null 2>&1; } 2>&1 ) || :
+        if [ -z "$best" ] || awk "BEGIN { exit !($time < $best) }"; then
+            best=$time
+        fi
+    done
+    echo "$best"
+}
+
+printf '%-12s %8s %8s %8s\n' program vm -O0 -O1
+for program in "$BENCH_DIR"/*.he; do
+    name=$(basename "$program" .he)
+    "$HELIUM" -O0 "$program" "$OUT_DIR/$name-O0"
+    "$HELIUM" -O1 "$program" "$OUT_DIR/$name-O1"
+    printf '%-12s %8s %8s %8s\n' "$name.he" \
+        "$(best "$HELIUM" vm "$program")" \
+        "$(best "$OUT_DIR/$name-O0")" \
+        "$(best "$OUT_DIR/$name-O1")"
+done
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "./parser.hpp"
+#include "./symbols.hpp"
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+
+// Works out the type of every expression once, right after parsing, and stores it in the node. The optimizer and code
+// generation only read Ast::type from then on.
+//
+// An operation is a str when either side is, an identifier has the type of the innermost let of that name in scope,
+// and anything that cannot be typed (undeclared names, calls) is a num. Undeclared names, number literals that do not
+// fit in 64 bits and exiting with a str are reported here, before the optimizer gets a chance to fold them out of
+// sight.
+class Analyzer {
+public:
+    explicit Analyzer(Diagnostics* diagnostics)
+        : m_diagnostics(diagnostics)
+    {
+    }
+
+    void analyze(Node::Ast* ast)
+    {
+        m_ast = ast;
+        for (const Node::Id statement : ast->list(ast->root())) {
+            analyze_statement(statement);
+        }
+    }
+
+private:
+    void analyze_scope(const Node::Id scope)
+    {
+        m_variables.begin_scope();
+        for (const Node::Id statement : m_ast->list(scope)) {
+            analyze_statement(statement);
+        }
+        m_variables.end_scope();
+    }
+
+    void analyze_statement(const Node::Id statement)
+    {
+        switch (m_ast->kind(statement)) {
+        case Node::Kind::Exit:
+            if (analyze_expression(m_ast->lhs(statement)) == Node::VariableType::STR) {
+                m_diagnostics->error(m_ast->position(statement), "exit codes are nums ya clown, not strs", 4);
+            }
+            break;
+        case Node::Kind::Print:
+        case Node::Kind::Assignment:
+        case Node::Kind::Return:
+            analyze_expression(m_ast->lhs(statement));
+            break;
+        case Node::Kind::Let: {
+            const Node::VariableType type = analyze_expression(m_ast->lhs(statement));
+            m_variables.declare(m_ast->token(statement).symbol, type);
+            break;
+        }
+        case Node::Kind::Scope:
+            analyze_scope(statement);
+            break;
+        case Node::Kind::If: {
+            const Node::IfParts parts = m_ast->if_parts(statement);
+            analyze_expression(parts.condition);
+            analyze_scope(parts.scope);
+            if (parts.else_ != Node::None) {
+                // an else-if is analyzed like any other if
+                analyze_statement(parts.else_);
+            }
+            break;
+        }
+        case Node::Kind::While:
+            analyze_expression(m_ast->lhs(statement));
+            analyze_scope(m_ast->rhs(statement));
+            break;
+        case Node::Kind::Function: {
+            const Node::FunctionParts parts = m_ast->function_parts(statement);
+            m_variables.begin_scope();
+            for (const Node::Id argument : parts.arguments) {
+                m_variables.declare(m_ast->token(argument).symbol, m_ast->datatype(argument));
+            }
+            analyze_scope(parts.scope);
+            m_variables.end_scope();
+            break;
+        }
+        default:
+            assert(false && "not a statement");
+        }
+    }
+
+    Node::VariableType analyze_expression(const Node::Id expression)
+    {
+        Node::VariableType type = Node::VariableType::NUM;
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::IntLiteral: {
+            const std::string_view digits = m_ast->token(expression).value.value();
+            uint64_t value = 0;
+            const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.length(), value);
+            if (error != std::errc() || end != digits.data() + digits.length()) {
+                m_diagnostics->error(
+                    m_ast->position(expression), "dat number dont fit in 64 bits ya greedy", digits.length());
+            }
+            break;
+        }
+        case Node::Kind::StrLiteral:
+            type = Node::VariableType::STR;
+            break;
+        case Node::Kind::Identifier: {
+            const Token& identifier = m_ast->token(expression);
+            if (const Node::VariableType* found = m_variables.find(identifier.symbol)) {
+                type = *found;
+                break;
+            }
+            m_diagnostics->error(
+                identifier.position, "ya using undeclared variables ya ass", identifier.value.value().length());
+            break;
+        }
+        case Node::Kind::Paren:
+            type = analyze_expression(m_ast->lhs(expression));
+            break;
+        case Node::Kind::Call:
+            for (const Node::Id argument : m_ast->list(expression)) {
+                analyze_expression(argument);
+            }
+            break;
+        case Node::Kind::Operation: {
+            const Node::VariableType left = analyze_expression(m_ast->lhs(expression));
+            const Node::VariableType right = analyze_expression(m_ast->rhs(expression));
+            if (left == Node::VariableType::STR || right == Node::VariableType::STR) {
+                type = Node::VariableType::STR;
+            }
+            break;
+        }
+        default:
+            assert(false && "not an expression");
+        }
+        m_ast->set_type(expression, type);
+        return type;
+    }
+
+    Diagnostics* m_diagnostics;
+    Node::Ast* m_ast = nullptr;
+    SymbolTable<Node::VariableType> m_variables {};
+};
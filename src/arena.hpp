@@ -1,22 +1,80 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
+struct ArenaStats {
+    // bytes handed out to callers
+    size_t bytes_used = 0;
+    // bytes malloc'd for blocks, headers included
+    size_t bytes_reserved = 0;
+    size_t blocks = 0;
+    // alignment padding, the unused tails of retired blocks and storage resize() moved away from
+    size_t waste = 0;
+};
+
+// Bump allocator over a chain of malloc'd blocks. Each new block is twice the size of the previous one, so any input
+// size fits without guessing the total up front. Requests of a quarter of the first block or more get a malloc'd block
+// to themselves instead, which resize() can realloc: an array that keeps growing moves the way a std::vector would
+// rather than leaving every outgrown copy behind.
 class ArenaAllocator final {
 public:
-    explicit ArenaAllocator(const size_t bytes)
-        : m_size(bytes)
+    explicit ArenaAllocator(const size_t block_size = 64 * 1024)
+        : m_next_block_size(block_size)
+        , m_large_size(block_size / 4)
     {
-        m_buffer = static_cast<std::byte*>(malloc(m_size));
-        m_offset = m_buffer;
     }
 
+    // raw storage for `count` objects of T, aligned for T. nothing is constructed.
     template <typename T>
-    T* alloc()
+    T* alloc(const size_t count = 1)
     {
-        void* offset = m_offset;
-        m_offset += sizeof(T);
-        return static_cast<T*>(offset);
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // constructs a T in the arena. a non-trivial destructor is registered and runs when the arena is destroyed.
+    template <typename T, typename... Args>
+    T* emplace(Args&&... args)
+    {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            m_finalizers = new (allocate(sizeof(Finalizer), alignof(Finalizer))) Finalizer {
+                .destroy = [](void* ptr) { static_cast<T*>(ptr)->~T(); },
+                .object = object,
+                .next = m_finalizers,
+            };
+        }
+        return object;
+    }
+
+    // copies `text` into the arena, for strings built after parsing that nodes have to view into
+    std::string_view store(const std::string_view text)
+    {
+        char* data = alloc<char>(text.length());
+        std::copy(text.begin(), text.end(), data);
+        return { data, text.length() };
+    }
+
+    // storage for `new_count` objects of T that starts with the first `count` of `data`, which may have moved. `data`
+    // must be the arena's, allocated for `count` objects. the most recent allocation grows in place when it can.
+    template <typename T>
+    T* resize(T* data, const size_t count, const size_t new_count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return static_cast<T*>(reallocate(data, sizeof(T) * count, sizeof(T) * new_count, alignof(T)));
+    }
+
+    [[nodiscard]] const ArenaStats& stats() const
+    {
+        return m_stats;
     }
 
     ArenaAllocator(const ArenaAllocator& other) = delete;
@@ -25,11 +83,216 @@ public:
 
     ~ArenaAllocator()
     {
-        free(m_buffer);
+        for (Finalizer* finalizer = m_finalizers; finalizer != nullptr; finalizer = finalizer->next) {
+            finalizer->destroy(finalizer->object);
+        }
+        while (m_block != nullptr) {
+            Block* prev = m_block->prev;
+            free(m_block);
+            m_block = prev;
+        }
+        while (m_large != nullptr) {
+            Large* next = m_large->next;
+            free(m_large);
+            m_large = next;
+        }
     }
 
 private:
-    size_t m_size;
-    std::byte* m_buffer;
-    std::byte* m_offset;
-};
\ No newline at end of file
+    struct Block {
+        Block* prev;
+        size_t size;
+    };
+
+    // header of a block holding one large allocation, which starts LargeHeader bytes in
+    struct Large {
+        Large* prev;
+        Large* next;
+    };
+
+    static constexpr size_t LargeHeader
+        = (sizeof(Large) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    struct Finalizer {
+        void (*destroy)(void*);
+        void* object;
+        Finalizer* next;
+    };
+
+    void* allocate(const size_t size, const size_t align)
+    {
+        if (size >= m_large_size) {
+            return allocate_large(size, align);
+        }
+        auto aligned = align_up(m_offset, align);
+        if (m_block == nullptr || aligned + size > m_end) {
+            grow(size + align);
+            aligned = align_up(m_offset, align);
+        }
+        m_stats.waste += aligned - m_offset;
+        m_stats.bytes_used += size;
+        m_offset = aligned + size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void* allocate_large(const size_t size, const size_t align)
+    {
+        assert(align <= alignof(std::max_align_t) && "malloc does not align that far");
+        auto large = static_cast<Large*>(malloc(LargeHeader + size));
+        if (large == nullptr) {
+            std::cerr << "arena ran out of memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        large->prev = nullptr;
+        large->next = m_large;
+        if (m_large != nullptr) {
+            m_large->prev = large;
+        }
+        m_large = large;
+        m_stats.bytes_used += size;
+        m_stats.bytes_reserved += LargeHeader + size;
+        m_stats.blocks++;
+        return reinterpret_cast<char*>(large) + LargeHeader;
+    }
+
+    // an allocation is large exactly when its size is at least m_large_size, extending in place never crosses that
+    void* reallocate(void* ptr, const size_t old_size, const size_t new_size, const size_t align)
+    {
+        if (ptr == nullptr) {
+            return allocate(new_size, align);
+        }
+        if (old_size >= m_large_size) {
+            auto large = static_cast<Large*>(realloc(static_cast<char*>(ptr) - LargeHeader, LargeHeader + new_size));
+            if (large == nullptr) {
+                std::cerr << "arena ran out of memory" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            // the neighbours still point at where the block was
+            if (large->prev != nullptr) {
+                large->prev->next = large;
+            }
+            else {
+                m_large = large;
+            }
+            if (large->next != nullptr) {
+                large->next->prev = large;
+            }
+            m_stats.bytes_used += new_size - old_size;
+            m_stats.bytes_reserved += new_size - old_size;
+            return reinterpret_cast<char*>(large) + LargeHeader;
+        }
+        const auto start = reinterpret_cast<uintptr_t>(ptr);
+        if (new_size < m_large_size && start + old_size == m_offset && start + new_size <= m_end) {
+            m_offset = start + new_size;
+            m_stats.bytes_used += new_size - old_size;
+            return ptr;
+        }
+        // the old storage stays behind, it is smaller than m_large_size
+        void* moved = allocate(new_size, align);
+        std::memcpy(moved, ptr, old_size);
+        m_stats.waste += old_size;
+        return moved;
+    }
+
+    void grow(const size_t min_size)
+    {
+        const size_t size = std::max(m_next_block_size, min_size + sizeof(Block));
+        auto block = static_cast<Block*>(malloc(size));
+        if (block == nullptr) {
+            std::cerr << "arena ran out of memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        block->prev = m_block;
+        block->size = size;
+        if (m_block != nullptr) {
+            m_stats.waste += m_end - m_offset;
+        }
+        m_block = block;
+        m_offset = reinterpret_cast<uintptr_t>(block) + sizeof(Block);
+        m_end = reinterpret_cast<uintptr_t>(block) + size;
+        m_next_block_size = size * 2;
+        m_stats.bytes_reserved += size;
+        m_stats.blocks++;
+    }
+
+    static uintptr_t align_up(const uintptr_t value, const size_t align)
+    {
+        return (value + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+    }
+
+    size_t m_next_block_size;
+    size_t m_large_size;
+    Block* m_block = nullptr;
+    Large* m_large = nullptr;
+    uintptr_t m_offset = 0;
+    uintptr_t m_end = 0;
+    Finalizer* m_finalizers = nullptr;
+    ArenaStats m_stats;
+};
+
+// Growable array whose storage lives in an ArenaAllocator, used for the AST's node arrays. Capacity doubles on growth
+// through ArenaAllocator::resize, so it happens in place when the array is the arena's latest allocation.
+// Elements must be trivially copyable, so the arrays need no destructor and go away with the arena.
+template <typename T>
+class ArenaVector {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+
+public:
+    ArenaVector() = default;
+
+    explicit ArenaVector(ArenaAllocator* arena)
+        : m_arena(arena)
+    {
+    }
+
+    void push_back(const T& value)
+    {
+        if (m_size == m_capacity) {
+            grow();
+        }
+        m_data[m_size++] = value;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_size;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    T& operator[](const size_t index) const
+    {
+        return m_data[index];
+    }
+
+    T* data() const
+    {
+        return m_data;
+    }
+
+    T* begin() const
+    {
+        return m_data;
+    }
+
+    T* end() const
+    {
+        return m_data + m_size;
+    }
+
+private:
+    void grow()
+    {
+        const size_t capacity = m_capacity == 0 ? 4 : m_capacity * 2;
+        m_data = m_arena->resize(m_data, m_size, capacity);
+        m_capacity = capacity;
+    }
+
+    ArenaAllocator* m_arena = nullptr;
+    T* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+};
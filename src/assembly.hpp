@@ -1,84 +1,267 @@
 #pragma once
 
 #include "./parser.hpp"
+#include "./regalloc.hpp"
+#include "./symbols.hpp"
+#include "./x86.hpp"
 #include <cassert>
-#include <ranges>
+#include <charconv>
+#include <string_view>
 #include <utility>
-#include <variant>
 
 const std::string RuntimeHelper = R"(
 section .bss
-    ; A small buffer for itoa conversions (max 20 digits for 64-bit int)
+    ; A small buffer for itoa conversions (max 20 digits and a sign for 64-bit int)
     itoa_buf resb 24 
-    ; Store the current heap pointer
+    ; Next free byte of the string heap, and the end of the memory brk has handed out so far
     heap_ptr resq 1
+    heap_end resq 1
+    ; Output waiting for _flush, and how much of it there is
+    out_buf resb 65536
+    out_len resq 1
+
+section .data
+    ; "00" to "99", the two digits of every n % 100
+    digit_pairs db "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                db "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                db "8081828384858687888990919293949596979899"
+    out_of_memory_message db "out of memory, brk said no", 10
 
 section .text
 
 ; --- itoa: converts RAX to string ---
+; Two digits per step: n / 100 is a multiply by the reciprocal, n % 100 indexes digit_pairs
 ; Returns: RAX = pointer, RDX = length
 _itoa:
-    mov rbx, 10
-    mov rcx, itoa_buf + 23
-    xor rsi, rsi
-.loop:
-    xor rdx, rdx
-    div rbx
-    add dl, '0'
-    dec rcx
-    mov [rcx], dl
-    inc rsi
-    test rax, rax
-    jnz .loop
-    mov rax, rcx
-    mov rdx, rsi
+    mov rsi, itoa_buf + 24  ; digits are written backwards from the end
+    mov rdi, rsi
+.pair:
+    cmp rax, 100
+    jb .last
+    mov rbx, rax
+    shr rax, 2
+    mov rcx, 0x28F5C28F5C28F5C3
+    mul rcx
+    shr rdx, 2              ; RDX = n / 100
+    imul rcx, rdx, 100
+    sub rbx, rcx            ; RBX = n % 100
+    mov rax, rdx
+    movzx ecx, WORD [digit_pairs + rbx * 2]
+    sub rsi, 2
+    mov [rsi], cx
+    jmp .pair
+.last:
+    cmp rax, 10
+    jb .digit
+    movzx ecx, WORD [digit_pairs + rax * 2]
+    sub rsi, 2
+    mov [rsi], cx
+    jmp .done
+.digit:
+    add al, '0'
+    dec rsi
+    mov [rsi], al
+.done:
+    mov rax, rsi
+    mov rdx, rdi
+    sub rdx, rsi
     ret
 
-; --- runtime_concat ---
-; Inputs: R15/R14 (LHS ptr/len), R13/R12 (RHS ptr/len)
-; Returns: RAX (new ptr), RDX (total len)
-_runtime_concat:
-    ; 1. Calculate total length
-    mov rdx, r14
-    add rdx, r12
-    push rdx            ; Save total length to return later
+; --- itoa_signed: like itoa, reading RAX as two's complement ---
+_itoa_signed:
+    test rax, rax
+    jns _itoa
+    neg rax                 ; the magnitude of the smallest number is still right read unsigned
+    call _itoa
+    dec rax
+    mov BYTE [rax], '-'
+    inc rdx
+    ret
 
-    ; 2. Get current heap break if not initialized
+; --- heap_mark: makes sure there is a heap, returns RAX = heap_ptr ---
+; Putting the mark back into heap_ptr frees everything allocated since
+_heap_mark:
     mov rax, [heap_ptr]
     test rax, rax
-    jnz .allocate
+    jnz .marked
     mov rax, 12         ; sys_brk
     xor rdi, rdi        ; 0 returns current break
     syscall
     mov [heap_ptr], rax
+    mov [heap_end], rax
+.marked:
+    ret
 
-.allocate:
-    mov rdi, [heap_ptr]
-    add rdi, [rsp]      ; new break = old break + total length
+; --- heap_alloc: bumps heap_ptr by RDX bytes, returns RAX = the start of them ---
+; The break only moves when the current chunk runs out, up to the next 1 MB boundary
+_heap_alloc:
+    call _heap_mark
+    lea rdi, [rax + rdx]
+    cmp rdi, [heap_end]
+    jbe .bumped
+    add rdi, 0xFFFFF
+    and rdi, -0x100000
+    push rax
+    push rdi
     mov rax, 12         ; sys_brk
     syscall             ; RAX now has the NEW break
-    
-    mov rbx, [heap_ptr] ; RBX = start of our new memory
-    mov [heap_ptr], rax ; Update heap_ptr for next call
-    
-    ; 3. Copy LHS
+    pop rdi
+    cmp rax, rdi
+    jb .out_of_memory
+    mov [heap_end], rax
+    pop rax
+    lea rdi, [rax + rdx]
+.bumped:
+    mov [heap_ptr], rdi
+    ret
+.out_of_memory:
+    call _flush         ; what the program printed so far comes before the complaint
+    mov rax, 1          ; sys_write
+    mov rdi, 2          ; stderr
+    mov rsi, out_of_memory_message
+    mov rdx, 27
+    syscall
+    mov rdi, 12         ; ENOMEM
+    jmp _exit
+
+; --- runtime_concat ---
+; Inputs: R15/R14 (LHS ptr/len), R13/R12 (RHS ptr/len)
+; Returns: RAX (new ptr), RDX (total len)
+_runtime_concat:
+    mov rdx, r14
+    add rdx, r12        ; total length
+    call _heap_alloc
+    mov rdi, rax        ; dest
     mov rsi, r15        ; src
-    mov rdi, rbx        ; dest
     mov rcx, r14        ; len
-    rep movsb           ; copy bytes
-    
-    ; 4. Copy RHS
-    mov rsi, r13        ; src
+    rep movsb           ; copy LHS
     ; RDI is already pointing to the end of LHS after rep movsb
+    mov rsi, r13        ; src
     mov rcx, r12        ; len
+    rep movsb           ; copy RHS
+    ret
+
+; --- runtime_concat_n: joins RCX pieces into one new string ---
+; RSI points at the pieces as they were pushed, so the last one comes first. Each is 16 bytes: ptr and len for a
+; string, or the value and -1 for a number
+; Returns: RAX (new ptr), RDX (total len)
+_runtime_concat_n:
+    mov r12, rsi            ; R12 = the last piece
+    shl rcx, 4
+    lea r13, [rsi + rcx]    ; R13 = one past the first piece
+    ; 1. Bound the total length, a number is at most 20 digits
+    xor rdx, rdx
+    mov rdi, r13
+.bound:
+    sub rdi, 16
+    mov rax, [rdi + 8]
+    cmp rax, -1
+    jne .counted
+    mov rax, 20
+.counted:
+    add rdx, rax
+    cmp rdi, r12
+    jne .bound
+    ; 2. Reserve that much and copy the pieces in, numbers converted on the way
+    call _heap_alloc
+    mov r14, rax            ; R14 = start of the new string
+    mov r15, rax            ; R15 = where the next piece goes
+.copy:
+    sub r13, 16
+    mov rsi, [r13]
+    mov rcx, [r13 + 8]
+    cmp rcx, -1
+    jne .string
+    mov rax, rsi
+    call _itoa
+    mov rsi, rax
+    mov rcx, rdx
+.string:
+    mov rdi, r15
     rep movsb
-    
-    mov rax, rbx        ; Return the start of the new string
-    pop rdx             ; Return the total length
+    mov r15, rdi
+    cmp r13, r12
+    jne .copy
+    ; 3. Give back what the numbers did not need
+    mov [heap_ptr], r15
+    mov rax, r14
+    mov rdx, r15
+    sub rdx, r14
     ret
+
+; --- print_n: prints RCX pieces laid out as for runtime_concat_n, without joining them ---
+_print_n:
+    mov r12, rsi
+    shl rcx, 4
+    lea r13, [rsi + rcx]
+.piece:
+    sub r13, 16
+    mov rsi, [r13]
+    mov rdx, [r13 + 8]
+    cmp rdx, -1
+    jne .print
+    mov rax, rsi
+    call _itoa
+    mov rsi, rax
+.print:
+    call _print
+    cmp r13, r12
+    jne .piece
+    ret
+
+; --- print: appends RSI/RDX (ptr/len) to the output buffer ---
+; Flushes first when it does not fit, text bigger than the whole buffer is written straight through
+_print:
+    mov rax, [out_len]
+    add rax, rdx
+    cmp rax, 65536
+    jbe .append
+    push rsi
+    push rdx
+    call _flush
+    pop rdx
+    pop rsi
+    cmp rdx, 65536
+    ja _write
+.append:
+    mov rdi, out_buf
+    add rdi, [out_len]
+    add [out_len], rdx
+    mov rcx, rdx
+    rep movsb
+    ret
+
+; --- flush: writes out and empties the output buffer ---
+_flush:
+    mov rsi, out_buf
+    mov rdx, [out_len]
+    mov QWORD [out_len], 0
+    ; falls through
+; --- write: writes RSI/RDX (ptr/len) to stdout, however many syscalls it takes ---
+_write:
+    test rdx, rdx
+    jz .written
+    mov rax, 1          ; sys_write
+    mov rdi, 1          ; stdout
+    syscall
+    test rax, rax
+    jle .written        ; nowhere to report a failed write to, drop the rest
+    add rsi, rax
+    sub rdx, rax
+    jmp _write
+.written:
+    ret
+
+; --- exit: flushes the output buffer, then exits with RDI ---
+_exit:
+    push rdi
+    call _flush
+    pop rdi
+    mov rax, 60         ; sys_exit
+    syscall
 )";
 
-std::string process_escape_sequences(const std::string& input, size_t& out_len)
+std::string process_escape_sequences(const std::string_view input, size_t& out_len)
 {
     std::string result;
     out_len = 0;
@@ -121,68 +304,74 @@ std::string process_escape_sequences(const std::string& input, size_t& out_len)
     return result;
 }
 
+struct GeneratorOptions {
+    // 0 is the plain stack machine. 1 keeps num variables in registers and feeds leaves to instructions directly.
+    int opt_level = 0;
+    // print writes straight to stdout instead of through the runtime's output buffer, for interactive use
+    bool unbuffered_output = false;
+};
+
 class AssGenerator {
 public:
-    AssGenerator(Node::Program prog, ArenaAllocator* allocator)
-        : m_prog(std::move(prog))
-        , m_allocator(allocator)
+    AssGenerator(const Node::Ast* ast, Diagnostics* diagnostics, GeneratorOptions options = {})
+        : m_ast(ast)
+        , m_diagnostics(diagnostics)
+        , m_options(options)
     {
     }
 
-    std::string generate_program()
+    X86::Code generate_program()
     {
-        m_asmout.clear();
-        m_asmout << "global _start\n_start:\n";
+        m_code = {};
+        m_code.raw("global _start\n");
+        m_code.label("_start");
+
+        if (m_options.opt_level >= 1) {
+            m_registers = RegisterAllocator().allocate(*m_ast);
+        }
 
-        for (const Node::Statement::Statement* statement : m_prog.stmts) {
+        for (const Node::Id statement : m_ast->list(m_ast->root())) {
             generate_statement(statement);
         }
 
         // default this runs
-        m_asmout << "    ; default execution\n";
-        m_asmout << "    mov rax, 60\n";
-        m_asmout << "    mov rdi, 0\n";
-        m_asmout << "    syscall\n";
+        m_code.comment("default execution");
+        m_code.emit("mov", { "rdi", "0" });
+        m_code.emit("jmp", { "_exit" });
         // static strings
         if (m_strings.size() > 0) {
-            m_asmout << "section .data\n";
+            m_code.raw("section .data\n");
         }
         for (const auto str : m_strings) {
             size_t length = 0;
             std::string processed = process_escape_sequences(str.value, length);
-            m_asmout << "    " << str.label << " db \"" << processed << "\", 0\n";
+            m_code.raw("    " + str.label + " db \"" + processed + "\", 0\n");
         }
         // runtime helpers
-        m_asmout << RuntimeHelper << "\n";
-        return m_asmout.str();
+        m_code.raw(RuntimeHelper + "\n");
+        return std::move(m_code);
     }
 
 private:
-    void stack_push(const std::string& reg)
+    void stack_push(const std::string_view operand)
     {
-        m_asmout << "    push " << reg << "\n";
+        m_code.emit("push", { operand });
         m_stack_counter++;
     }
-    void stack_pop(const std::string& reg)
+    void stack_pop(const std::string_view operand)
     {
-        m_asmout << "    pop " << reg << "\n";
+        m_code.emit("pop", { operand });
         m_stack_counter--;
     }
 
-    void begin_scope()
-    {
-        m_scopes.push_back(m_variables.size());
-    }
-
     void end_scope()
     {
-        const size_t pop_count = m_variables.size() - m_scopes.back();
         size_t total_slots_to_pop = 0;
-        const size_t vars_in_scope = m_variables.size() - m_scopes.back();
-
-        // Iterate backwards through the variables we are about to remove
-        for (size_t i = 0; i < vars_in_scope; ++i) {
-            const auto& var = m_variables.at(m_variables.size() - 1 - i);
+        for (const auto& entry : m_variables.scope()) {
+            const Variable& var = entry.value;
+            if (var.reg.has_value()) {
+                continue;
+            }
             if (var.type == Node::VariableType::STR) {
                 total_slots_to_pop += 2;
             }
@@ -192,470 +381,711 @@ private:
         }
         // Adjust the physical stack pointer
         if (total_slots_to_pop > 0) {
-            m_asmout << "    add rsp, " << total_slots_to_pop * 8 << "\n";
+            m_code.emit("add", { "rsp", std::to_string(total_slots_to_pop * 8) });
             m_stack_counter -= total_slots_to_pop;
         }
 
         // Remove from our metadata tracking
-        for (size_t i = 0; i < vars_in_scope; i++) {
-            m_variables.pop_back();
-        }
-        m_scopes.pop_back();
+        m_variables.end_scope();
     }
 
-    std::string create_label()
+    // stands in for an expression that failed to compile, so the stack layout stays consistent and generation can go
+    // on to report the rest of the program's errors
+    void stack_push_placeholder(const Node::VariableType type)
     {
-        return "label" + std::to_string(m_label_count++);
+        m_code.emit("xor", { "rax", "rax" });
+        stack_push("rax");
+        if (type == Node::VariableType::STR) {
+            stack_push("rax");
+        }
     }
 
-    void generate_term(const Node::Expression::Term* term)
+    // the `+` of a string, which is all a str operation that is not an error can be
+    bool is_concat(const Node::Id expression)
     {
-        struct TermVisitor {
-            AssGenerator& generator;
+        return m_ast->kind(expression) == Node::Kind::Operation && m_ast->token(expression).value.value() == "+"
+            && m_ast->type(expression) == Node::VariableType::STR;
+    }
 
-            void operator()(const Node::Expression::Identifier* identifier_node) const
-            {
-                const auto variable
-                    = std::ranges::find_if(std::as_const(generator.m_variables), [&](const Variable& var) {
-                          return var.name == identifier_node->ident.value.value();
-                      });
-                if (variable == generator.m_variables.cend()) {
-                    std::cerr << "ya using undeclared variables ya ass" << identifier_node->current_position().str()
-                              << std::endl;
-                    exit(EXIT_FAILURE);
-                }
-                generator.m_asmout << "    ; generate identifier" << "\n";
-                if (variable->type == Node::VariableType::STR) {
-                    size_t len_offset = (generator.m_stack_counter - variable->stack_loc - 1) * 8;
-                    generator.m_asmout << "    mov rax, QWORD [rsp + " << len_offset << "]\n";
-                    generator.stack_push("rax");
-
-                    size_t ptr_offset = (generator.m_stack_counter - (variable->stack_loc + 1) - 1) * 8;
-                    generator.m_asmout << "    mov rax, QWORD [rsp + " << ptr_offset << "]\n";
-                    generator.stack_push("rax");
-                }
-                else {
-                    std::stringstream register_name;
-                    register_name << "QWORD [rsp + " << (generator.m_stack_counter - variable->stack_loc - 1) * 8
-                                  << "]";
-                    generator.stack_push(register_name.str());
-                }
-            };
-            void operator()(const Node::Expression::ParenthExpression* parenth_expression) const
-            {
-                generator.m_asmout << "    ; generate parenthesis expression" << "\n";
-                generator.generate_expression(parenth_expression->expression);
-            };
-            void operator()(const Node::Expression::IntLiteral* int_literal) const
-            {
-                generator.m_asmout << "    ; generate literal" << "\n";
-                generator.m_asmout << "    mov rax, " << int_literal->int_lit.value.value() << "\n";
-                generator.stack_push("rax");
-            };
-            void operator()(const Node::Expression::StrLiteral* str_literal) const
-            {
-                // 1. Extract the raw string value
-                std::string val = str_literal->str_lit.value.value();
+    // the operands of a chain of concatenations, in string order. `a + (b + c)` is as flat as `a + b + c`.
+    void collect_pieces(const Node::Id expression, std::vector<Node::Id>& pieces)
+    {
+        if (m_ast->kind(expression) == Node::Kind::Paren && m_ast->type(expression) == Node::VariableType::STR) {
+            collect_pieces(m_ast->lhs(expression), pieces);
+            return;
+        }
+        if (is_concat(expression)) {
+            collect_pieces(m_ast->lhs(expression), pieces);
+            collect_pieces(m_ast->rhs(expression), pieces);
+            return;
+        }
+        pieces.push_back(expression);
+    }
 
-                // 2. Create a unique label for the .data section
-                // We use the current size of m_strings to ensure it's unique (str_0, str_1, etc.)
-                std::string label = "str_" + std::to_string(generator.m_strings.size());
+    // pushes every piece of a concatenation chain the way _runtime_concat_n and _print_n read them: a str as its
+    // length and pointer, a num as -1 and its value. leaves rsi pointing at them and rcx holding how many there are.
+    size_t push_pieces(const Node::Id operation)
+    {
+        std::vector<Node::Id> pieces;
+        collect_pieces(m_ast->lhs(operation), pieces);
+        collect_pieces(m_ast->rhs(operation), pieces);
+        for (const Node::Id piece : pieces) {
+            if (m_ast->type(piece) == Node::VariableType::STR) {
+                generate_expression(piece);
+            }
+            else if (direct_num(piece)) {
+                stack_push("-1");
+                generate_num(piece);
+                stack_push("rax");
+            }
+            else {
+                stack_push("-1");
+                generate_expression(piece);
+            }
+        }
+        m_code.emit("mov", { "rsi", "rsp" });
+        m_code.emit("mov", { "rcx", std::to_string(pieces.size()) });
+        return pieces.size();
+    }
 
-                size_t actual_len = 0;
-                process_escape_sequences(val, actual_len);
+    void pop_pieces(const size_t count)
+    {
+        m_code.emit("add", { "rsp", std::to_string(count * 16) });
+        m_stack_counter -= count * 2;
+    }
 
-                // 3. Register the string for the .data section emission
-                generator.m_strings.push_back({ label, val });
+    // joins a whole chain at once, so every piece is copied exactly once. leaves the string in rax/rdx.
+    void generate_concat(const Node::Id operation)
+    {
+        m_code.comment("--- String Concatenation ---");
+        const size_t count = push_pieces(operation);
+        m_code.emit("call", { "_runtime_concat_n" });
+        pop_pieces(count);
+    }
 
-                // 4. Push the Length (Slot 1)
-                generator.m_asmout << "    mov rax, " << actual_len << " ; string length\n";
-                generator.stack_push("rax");
+    // a str expression that builds a new string on the heap rather than naming an existing one
+    bool allocates_string(const Node::Id expression)
+    {
+        return m_ast->type(expression) == Node::VariableType::STR && m_ast->kind(expression) != Node::Kind::StrLiteral
+            && m_ast->kind(expression) != Node::Kind::Identifier;
+    }
 
-                // 5. Push the Address (Slot 2)
-                // 'lea' (Load Effective Address) gets the memory address of our label
-                generator.m_asmout << "    lea rax, [" << label << "] ; string pointer\n";
-                generator.stack_push("rax");
-            };
-            void operator()(const Node::Expression::FunctionCall* func_call) const
-            {
-                assert(false && "not implemented");
-            };
-        };
+    // strings a statement only looks at are freed when it is done with them, by putting heap_ptr back where it was
+    void heap_mark()
+    {
+        m_code.emit("call", { "_heap_mark" });
+        stack_push("rax");
+    }
+    void heap_release()
+    {
+        stack_pop("QWORD [heap_ptr]");
+    }
 
-        TermVisitor visitor = { .generator = *this };
-        std::visit(visitor, term->term);
+    std::string create_label()
+    {
+        return "label" + std::to_string(m_label_count++);
     }
 
-    void generate_scope(const Node::Scope* scope)
+    void generate_scope(const Node::Id scope)
     {
-        m_asmout << "    ; generate scope" << "\n";
-        begin_scope();
-        for (const Node::Statement::Statement* statement : scope->stmts) {
+        m_code.comment("generate scope");
+        m_variables.begin_scope();
+        for (const Node::Id statement : m_ast->list(scope)) {
             generate_statement(statement);
         }
         end_scope();
     }
 
-    Node::VariableType infer_type(const Node::Expression::Expression* expr)
+    // at -O1 num expressions are computed straight into rax rather than through the stack
+    bool direct_num(const Node::Id expression)
+    {
+        return m_options.opt_level >= 1 && m_ast->type(expression) == Node::VariableType::NUM;
+    }
+
+    // a num leaf usable as an instruction operand: an immediate, a register or a stack slot
+    std::optional<std::string> num_operand(const Node::Id expression)
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::IntLiteral:
+            return std::string(m_ast->token(expression).value.value());
+        case Node::Kind::Paren:
+            return num_operand(m_ast->lhs(expression));
+        case Node::Kind::Identifier:
+            break;
+        default:
+            return {};
+        }
+        const Variable* variable = m_variables.find(m_ast->token(expression).symbol);
+        if (variable == nullptr || variable->type != Node::VariableType::NUM) {
+            return {};
+        }
+        if (variable->reg.has_value()) {
+            return std::string(variable->reg.value());
+        }
+        return variable_slot(*variable);
+    }
+
+    // immediates that sign extend to themselves, the only ones add/sub/imul take
+    static bool is_imm32(const std::string& operand)
+    {
+        uint64_t value = 0;
+        const auto [end, error] = std::from_chars(operand.data(), operand.data() + operand.length(), value);
+        return error == std::errc() && end == operand.data() + operand.length() && value <= 0x7FFFFFFF;
+    }
+
+    static bool is_immediate(const std::string& operand)
+    {
+        return Scan::is_digit(operand.front());
+    }
+
+    // leaves the value of a num expression in rax
+    void generate_num(const Node::Id expression)
+    {
+        if (const auto operand = num_operand(expression)) {
+            m_code.emit("mov", { "rax", operand.value() });
+        }
+        else if (m_ast->kind(expression) == Node::Kind::Operation) {
+            generate_num_operation(expression);
+        }
+        else if (m_ast->kind(expression) == Node::Kind::Paren) {
+            generate_num(m_ast->lhs(expression));
+        }
+        else {
+            generate_expression(expression);
+            stack_pop("rax");
+        }
+    }
+
+    void generate_num_into(const std::string_view reg, const Node::Id expression)
     {
-        if (auto* op_ptr = std::get_if<Node::Expression::Operation*>(&expr->expression)) {
-            auto* op = *op_ptr;
-            if (infer_type(op->left_hand) == Node::VariableType::STR
-                || infer_type(op->right_hand) == Node::VariableType::STR) {
-                return Node::VariableType::STR;
+        if (const auto operand = num_operand(expression)) {
+            if (operand.value() != reg) {
+                m_code.emit("mov", { reg, operand.value() });
             }
-            return Node::VariableType::NUM;
+            return;
         }
-        else if (auto* term_ptr = std::get_if<Node::Expression::Term*>(&expr->expression)) {
-            auto* term = *term_ptr;
-            if (std::holds_alternative<Node::Expression::IntLiteral*>(term->term)) {
-                return Node::VariableType::NUM;
+        generate_num(expression);
+        m_code.emit("mov", { reg, "rax" });
+    }
+
+    // rax = lhs op rhs. a leaf on the right is used in place, anything else is computed first and parked on the stack.
+    void generate_num_operation(const Node::Id operation)
+    {
+        const char op = m_ast->token(operation).value.value().front();
+        const Node::Id left_hand = m_ast->lhs(operation);
+        const Node::Id right_hand = m_ast->rhs(operation);
+        std::string source = "rbx";
+        if (auto operand = num_operand(right_hand)) {
+            generate_num(left_hand);
+            source = operand.value();
+            if (is_immediate(source) && (op == '/' || !is_imm32(source))) {
+                m_code.emit("mov", { "rbx", source });
+                source = "rbx";
             }
-            if (std::holds_alternative<Node::Expression::StrLiteral*>(term->term)) {
-                return Node::VariableType::STR;
+        }
+        else {
+            generate_num(right_hand);
+            stack_push("rax");
+            generate_num(left_hand);
+            stack_pop("rbx");
+        }
+        switch (op) {
+        case '+':
+            m_code.emit("add", { "rax", source });
+            break;
+        case '-':
+            m_code.emit("sub", { "rax", source });
+            break;
+        case '*':
+            // the low 64 bits are the same as mul's, without clobbering rdx
+            if (is_immediate(source)) {
+                m_code.emit("imul", { "rax", "rax", source });
             }
-            if (auto* ident_ptr = std::get_if<Node::Expression::Identifier*>(&term->term)) {
-                // Look up existing variable type
-                auto var = std::ranges::find_if(m_variables, [&](const Variable& v) {
-                    return v.name == (*ident_ptr)->ident.value.value();
-                });
-                return (var != m_variables.end()) ? var->type : Node::VariableType::NUM;
+            else {
+                m_code.emit("imul", { "rax", source });
             }
-            if (auto* paren_ptr = std::get_if<Node::Expression::ParenthExpression*>(&term->term)) {
-                return infer_type((*paren_ptr)->expression);
+            break;
+        case '/':
+            m_code.emit("xor", { "edx", "edx" });
+            m_code.emit("div", { source });
+            break;
+        default:
+            assert(false); // not implemented
+        }
+    }
+
+    void generate_expression(const Node::Id expression)
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::Identifier:
+            generate_identifier(expression);
+            break;
+        case Node::Kind::Paren:
+            m_code.comment("generate parenthesis expression");
+            generate_expression(m_ast->lhs(expression));
+            break;
+        case Node::Kind::IntLiteral:
+            m_code.comment("generate literal");
+            m_code.emit("mov", { "rax", m_ast->token(expression).value.value() });
+            stack_push("rax");
+            break;
+        case Node::Kind::StrLiteral:
+            generate_str_literal(expression);
+            break;
+        case Node::Kind::Call: {
+            const Token& ident = m_ast->token(expression);
+            m_diagnostics->error(ident.position, "fn calls aint a thing yet ya dreamer", ident.value.value().length());
+            stack_push_placeholder(Node::VariableType::NUM);
+            break;
+        }
+        case Node::Kind::Operation:
+            generate_operation(expression);
+            break;
+        default:
+            assert(false && "not an expression");
+        }
+    }
+
+    void generate_identifier(const Node::Id identifier)
+    {
+        const Token& ident = m_ast->token(identifier);
+        const Variable* variable = m_variables.find(ident.symbol);
+        if (variable == nullptr) {
+            // already reported by the Analyzer
+            stack_push_placeholder(Node::VariableType::NUM);
+            return;
+        }
+        m_code.comment("generate identifier");
+        if (variable->reg.has_value()) {
+            stack_push(std::string(variable->reg.value()));
+        }
+        else if (variable->type == Node::VariableType::STR) {
+            m_code.emit("mov", { "rax", variable_slot(*variable) });
+            stack_push("rax");
+
+            m_code.emit("mov", { "rax", variable_slot(*variable, 1) });
+            stack_push("rax");
+        }
+        else {
+            stack_push(variable_slot(*variable));
+        }
+    }
+
+    void generate_str_literal(const Node::Id literal)
+    {
+        // 1. Extract the raw string value
+        std::string_view val = m_ast->token(literal).value.value();
+
+        // 2. Find or create its label in the .data section
+        // Equal literals intern to the same symbol and share one label (str_0, str_1, etc.)
+        const Symbol symbol = m_ast->token(literal).symbol;
+        assert(symbol != NoSymbol);
+        if (symbol >= m_string_index.size()) {
+            m_string_index.resize(symbol + 1, NoString);
+        }
+        if (m_string_index[symbol] == NoString) {
+            // 3. Register the string for the .data section emission
+            m_string_index[symbol] = m_strings.size();
+            m_strings.push_back({ "str_" + std::to_string(m_strings.size()), val });
+        }
+        const std::string& label = m_strings[m_string_index[symbol]].label;
+
+        size_t actual_len = 0;
+        process_escape_sequences(val, actual_len);
+
+        // 4. Push the Length (Slot 1)
+        m_code.emit("mov", { "rax", std::to_string(actual_len) }, "string length");
+        stack_push("rax");
+
+        // 5. Push the Address (Slot 2)
+        // 'lea' (Load Effective Address) gets the memory address of our label
+        m_code.emit("lea", { "rax", "[" + label + "]" }, "string pointer");
+        stack_push("rax");
+    }
+
+    void generate_operation(const Node::Id operation)
+    {
+        const Node::Id left_hand = m_ast->lhs(operation);
+        const Node::Id right_hand = m_ast->rhs(operation);
+        const std::string_view oprator = m_ast->token(operation).value.value();
+        auto left_type = m_ast->type(left_hand);
+        auto right_type = m_ast->type(right_hand);
+
+        if (left_type == Node::VariableType::STR || right_type == Node::VariableType::STR) {
+            if (oprator != "+") {
+                m_diagnostics->error(
+                    m_ast->position(operation), "ya cannot perform " + std::string(oprator) + " on strings ya ass");
+                stack_push_placeholder(Node::VariableType::STR);
+                return;
+            }
+        }
+
+        m_code.comment("generate operation");
+        if (m_options.opt_level >= 1 && left_type == Node::VariableType::NUM && right_type == Node::VariableType::NUM) {
+            generate_num_operation(operation);
+            stack_push("rax");
+        }
+        else if (oprator == "+") {
+            if (left_type == Node::VariableType::STR || right_type == Node::VariableType::STR) {
+                generate_concat(operation);
+                stack_push("rdx"); // length
+                stack_push("rax"); // pointer
+            }
+            else {
+                m_code.comment("generate add");
+                generate_expression(left_hand);
+                generate_expression(right_hand);
+                stack_pop("rax");
+                stack_pop("rbx");
+                m_code.emit("add", { "rax", "rbx" });
+                stack_push("rax");
             }
         }
-        assert(false && "Should never happen");
+        else if (oprator == "-") {
+            m_code.comment("generate subtract");
+            generate_expression(left_hand);
+            generate_expression(right_hand);
+            stack_pop("rbx");
+            stack_pop("rax");
+            m_code.emit("sub", { "rax", "rbx" });
+            stack_push("rax");
+        }
+        else if (oprator == "*") {
+            m_code.comment("generate multiply");
+            generate_expression(left_hand);
+            generate_expression(right_hand);
+            stack_pop("rax");
+            stack_pop("rbx");
+            m_code.emit("mul", { "rbx" });
+            stack_push("rax");
+        }
+        else if (oprator == "/") {
+            m_code.comment("generate divide");
+            generate_expression(left_hand);
+            generate_expression(right_hand);
+            stack_pop("rbx");
+            stack_pop("rax");
+            m_code.emit("div", { "rbx" });
+            stack_push("rax");
+        }
+        else {
+            assert(false); // not implemented
+        }
     }
 
-    void generate_expression(const Node::Expression::Expression* expression)
+    void generate_statement(const Node::Id statement)
     {
-        struct ExpressionVisitor {
-            AssGenerator& generator;
+        switch (m_ast->kind(statement)) {
+        case Node::Kind::Exit:
+            generate_exit(statement);
+            break;
+        case Node::Kind::Print:
+            generate_print(statement);
+            break;
+        case Node::Kind::Let:
+            generate_let(statement);
+            break;
+        case Node::Kind::Assignment:
+            generate_assignment(statement);
+            break;
+        case Node::Kind::Scope:
+            generate_scope(statement);
+            break;
+        case Node::Kind::If:
+            generate_if(statement);
+            break;
+        case Node::Kind::While:
+            generate_while(statement);
+            break;
+        case Node::Kind::Function:
+            m_diagnostics->error(m_ast->position(statement), "fns aint a thing yet ya dreamer", 2);
+            break;
+        case Node::Kind::Return:
+            m_diagnostics->error(m_ast->position(statement), "return to where ya dreamer", 6);
+            break;
+        default:
+            assert(false && "not a statement");
+        }
+    }
 
-            void operator()(const Node::Expression::Term* term) const
-            {
-                generator.m_asmout << "    ; generate term" << "\n";
-                generator.generate_term(term);
-            };
-            void operator()(Node::Expression::Operation* operation) const
-            {
-                auto left_type = generator.infer_type(operation->left_hand);
-                auto right_type = generator.infer_type(operation->right_hand);
-
-                if (left_type == Node::VariableType::STR || right_type == Node::VariableType::STR) {
-                    if (operation->oprator.value.value() != "+") {
-                        auto op = operation->oprator.value.value();
-                        std::cerr << "ya cannot perform " << op << "on strings ya ass "
-                                  << operation->current_position().str() << std::endl;
-                        exit(EXIT_FAILURE);
-                    }
-                }
-
-                generator.m_asmout << "    ; generate operation" << "\n";
-                if (operation->oprator.value.value() == "+") {
-                    if (left_type == Node::VariableType::STR || right_type == Node::VariableType::STR) {
-                        generator.m_asmout << "    ; --- String Concatenation ---" << "\n";
-
-                        generator.generate_expression(operation->left_hand);
-                        generator.generate_expression(operation->right_hand);
-
-                        // 1. Pop RHS (could be 1 or 2 slots)
-                        if (right_type == Node::VariableType::STR) {
-                            generator.stack_pop("r13"); // ptr
-                            generator.stack_pop("r12"); // len
-                        }
-                        else {
-                            generator.stack_pop("rax");
-                            generator.m_asmout << "    call _itoa\n"; // Convert RAX to fat pointer in RAX/RDX
-                            generator.m_asmout << "    mov r13, rax\n";
-                            generator.m_asmout << "    mov r12, rdx\n";
-                        }
-
-                        // 2. Pop LHS (could be 1 or 2 slots)
-                        if (left_type == Node::VariableType::STR) {
-                            generator.stack_pop("r15"); // ptr
-                            generator.stack_pop("r14"); // len
-                        }
-                        else {
-                            generator.stack_pop("rax");
-                            generator.m_asmout << "    call _itoa\n";
-                            generator.m_asmout << "    mov r15, rax\n";
-                            generator.m_asmout << "    mov r14, rdx\n";
-                        }
-
-                        generator.m_asmout << "    call _runtime_concat\n";
-                        // 4. Push resulting fat pointer
-                        generator.stack_push("rdx"); // length
-                        generator.stack_push("rax"); // pointer
-                    }
-                    else {
-                        generator.m_asmout << "    ; generate add" << "\n";
-                        generator.generate_expression(operation->left_hand);
-                        generator.generate_expression(operation->right_hand);
-                        generator.stack_pop("rax");
-                        generator.stack_pop("rbx");
-                        generator.m_asmout << "    add rax, rbx\n";
-                        generator.stack_push("rax");
-                    }
-                }
-                else if (operation->oprator.value.value() == "-") {
-                    generator.m_asmout << "    ; generate subtract" << "\n";
-                    generator.generate_expression(operation->left_hand);
-                    generator.generate_expression(operation->right_hand);
-                    generator.stack_pop("rbx");
-                    generator.stack_pop("rax");
-                    generator.m_asmout << "    sub rax, rbx\n";
-                    generator.stack_push("rax");
-                }
-                else if (operation->oprator.value.value() == "*") {
-                    generator.m_asmout << "    ; generate multiply" << "\n";
-                    generator.generate_expression(operation->left_hand);
-                    generator.generate_expression(operation->right_hand);
-                    generator.stack_pop("rax");
-                    generator.stack_pop("rbx");
-                    generator.m_asmout << "    mul rbx\n";
-                    generator.stack_push("rax");
-                }
-                else if (operation->oprator.value.value() == "/") {
-                    generator.m_asmout << "    ; generate divide" << "\n";
-                    generator.generate_expression(operation->left_hand);
-                    generator.generate_expression(operation->right_hand);
-                    generator.stack_pop("rbx");
-                    generator.stack_pop("rax");
-                    generator.m_asmout << "    div rbx\n";
-                    generator.stack_push("rax");
-                }
-                else {
-                    assert(false); // not implemented
-                }
-            };
-        };
-
-        ExpressionVisitor visitor = { .generator = *this };
-        std::visit(visitor, expression->expression);
-    }
-
-    void generate_statement(const Node::Statement::Statement* statement)
-    {
-        struct StatementVisitor {
-            AssGenerator& generator;
-
-            void operator()(const Node::Statement::Exit* exit_node) const
-            {
-                generator.m_asmout << "    ; generate exit" << "\n";
-                generator.generate_expression(exit_node->expression);
-                generator.m_asmout << "    mov rax, 60\n";
-                generator.stack_pop("rdi");
-                generator.m_asmout << "    syscall\n";
-            };
-            void operator()(const Node::Statement::Print* print_node) const
-            {
-                generator.m_asmout << "    ; --- generate print ---" << "\n";
-
-                Node::VariableType type = generator.infer_type(print_node->expression);
-
-                generator.generate_expression(print_node->expression);
-
-                if (type == Node::VariableType::STR) {
-                    // Stack has: [Length, Pointer]
-                    // We pop in reverse order of the push
-                    generator.stack_pop("rsi"); // Pop Pointer into RSI (address of string)
-                    generator.stack_pop("rdx"); // Pop Length into RDX (count of bytes)
-                }
-                else {
-                    // Stack has: [Integer Value]
-                    generator.stack_pop("rax");
-                    generator.m_asmout << "    call _itoa\n";
-                    generator.m_asmout << "    mov rsi, rax\n";
-                    generator.m_asmout << "    mov rdx, rdx\n";
-                }
-
-                generator.m_asmout << "    mov rax, 1      ; sys_write\n";
-                generator.m_asmout << "    mov rdi, 1      ; stdout\n";
-                generator.m_asmout << "    syscall\n";
-            };
-            void operator()(const Node::Statement::Let* let_node) const
-            {
+    void generate_exit(const Node::Id exit_node)
+    {
+        m_code.comment("generate exit");
+        const Node::Id expression = m_ast->lhs(exit_node);
+        if (direct_num(expression)) {
+            generate_num(expression);
+            m_code.emit("mov", { "rdi", "rax" });
+            m_code.emit("jmp", { "_exit" });
+            return;
+        }
+        generate_expression(expression);
+        stack_pop("rdi");
+        m_code.emit("jmp", { "_exit" });
+    }
 
-                const auto variable
-                    = std::ranges::find_if(std::as_const(generator.m_variables), [&](const Variable& var) {
-                          return var.name == let_node->identifier.value.value();
-                      });
-
-                if (variable != generator.m_variables.cend()) {
-                    std::cerr << "ya reusin variables ya bitch" << let_node->current_position().str() << std::endl;
-                    exit(EXIT_FAILURE);
-                }
-                generator.m_asmout << "    ; generate variable" << "\n";
-                generator.m_variables.push_back(
-                    {
-                        .name = let_node->identifier.value.value(),
-                        .mutable_ = let_node->mutable_,
-                        .stack_loc = generator.m_stack_counter,
-                        .type = generator.infer_type(let_node->expression),
-                    });
-                generator.generate_expression(let_node->expression);
-            };
-            void operator()(const Node::Statement::Assignment* assign_node) const
-            {
+    void generate_print(const Node::Id print)
+    {
+        m_code.comment("--- generate print ---");
 
-                const auto variable
-                    = std::ranges::find_if(std::as_const(generator.m_variables), [&](const Variable& var) {
-                          return var.name == assign_node->identifier.value.value();
-                      });
-
-                if (variable == generator.m_variables.cend()) {
-                    std::cerr << "ya usin imaginary variables ya ugly piece of shit"
-                              << assign_node->current_position().str() << std::endl;
-                    exit(EXIT_FAILURE);
-                }
-
-                if (!variable->mutable_) {
-                    std::cerr << "ya messign with an immutable variable you dingus"
-                              << assign_node->current_position().str() << std::endl;
-                    exit(EXIT_FAILURE);
-                }
-                if (variable->type != generator.infer_type(assign_node->expression)) {
-                    std::cerr << "ya cannot reassign types, dingus " << assign_node->current_position().str()
-                              << std::endl;
-                    exit(EXIT_FAILURE);
-                }
-                generator.m_asmout << "    ; reassign variable" << "\n";
-                generator.generate_expression(assign_node->expression);
-                if (variable->type == Node::VariableType::STR) {
-                    // Pop the new fat pointer (ptr, then len)
-                    generator.stack_pop("rax"); // new ptr
-                    generator.stack_pop("rbx"); // new len
-
-                    generator.m_asmout << "    mov [rsp + " << (generator.m_stack_counter - variable->stack_loc - 1) * 8
-                                       << "], rbx" << "\n";
-                    generator.m_asmout << "    mov [rsp + "
-                                       << (generator.m_stack_counter - (variable->stack_loc + 1) - 1) * 8 << "], rax"
-                                       << "\n";
-                }
-                else {
-                    generator.stack_pop("rax");
-                    generator.m_asmout << "    mov [rsp + " << (generator.m_stack_counter - variable->stack_loc - 1) * 8
-                                       << "], rax" << "\n";
-                }
-            };
-            void operator()(const Node::Scope* scope_node) const
-            {
-                generator.generate_scope(scope_node);
-            };
-            void operator()(const Node::Statement::If* if_node) const
-            {
-                Node::VariableType type = generator.infer_type(if_node->expression);
-                generator.generate_expression(if_node->expression);
-                if (type == Node::VariableType::STR) {
-                    // Stack has: [Length, Pointer]
-                    generator.stack_pop("rax"); // Pop the pointer (we don't need it for truthiness)
-                    generator.stack_pop("rax"); // Pop the length into RAX
-                }
-                else {
-                    // Stack has: [Integer]
-                    generator.stack_pop("rax");
-                }
-                auto elselabel = generator.create_label();
-                auto skiplabel = generator.create_label();
-                generator.m_asmout << "    test rax, rax" << "\n";
-                if (if_node->else_.has_value()) {
-                    generator.m_asmout << "    ; jump to else" << "\n";
-                    generator.m_asmout << "    jz " << elselabel << "\n";
-                }
-                else {
-                    generator.m_asmout << "    ; jump to skip" << "\n";
-                    generator.m_asmout << "    jz " << skiplabel << "\n";
-                }
-                generator.m_asmout << "    ; inside if" << "\n";
-                generator.generate_scope(if_node->scope);
-                generator.m_asmout << "    jmp " << skiplabel << "\n";
-
-                if (if_node->else_.has_value()) {
-                    generator.m_asmout << elselabel << ":" << "\n";
-                    generator.m_asmout << "    ; inside else" << "\n";
-                    if (std::holds_alternative<Node::Scope*>(if_node->else_.value()->else_)) {
-                        auto scope = std::get<Node::Scope*>(if_node->else_.value()->else_);
-                        generator.generate_scope(scope);
-                    }
-                    else {
-                        auto elseifnode = std::get<Node::Statement::If*>(if_node->else_.value()->else_);
-                        (*this)(elseifnode);
-                    }
-                    generator.m_asmout << "    jmp " << skiplabel << "\n";
-                }
-
-                generator.m_asmout << skiplabel << ":" << "\n";
-                generator.m_asmout << "    ; outside if-elif chain" << "\n";
-            };
-            void operator()(const Node::Statement::While* while_node) const
-            {
-                Node::VariableType type = generator.infer_type(while_node->expression);
-                auto conditionlabel = generator.create_label();
-                generator.m_asmout << conditionlabel << ":" << "\n";
-                generator.generate_expression(while_node->expression);
-                if (type == Node::VariableType::STR) {
-                    // Stack has: [Length, Pointer]
-                    generator.stack_pop("rax"); // Pop the pointer (we don't need it for truthiness)
-                    generator.stack_pop("rax"); // Pop the length into RAX
-                }
-                else {
-                    // Stack has: [Integer]
-                    generator.stack_pop("rax");
-                }
-                auto skiplabel = generator.create_label();
-                generator.m_asmout << "    test rax, rax" << "\n";
-                generator.m_asmout << "    ; jump to skip" << "\n";
-                generator.m_asmout << "    jz " << skiplabel << "\n";
-                generator.m_asmout << "    ; inside while" << "\n";
-                generator.generate_scope(while_node->scope);
-                generator.m_asmout << "    jmp " << conditionlabel << "\n";
-
-                generator.m_asmout << skiplabel << ":" << "\n";
-                generator.m_asmout << "    ; outside while loop" << "\n";
-            };
-            void operator()(const Node::Statement::Function* function_definition) const
-            {
-                assert(false && "not implemented");
-            };
-            void operator()(const Node::Statement::Return* return_stmt) const
+        const Node::Id expression = m_ast->lhs(print);
+        Node::VariableType type = m_ast->type(expression);
+        if (!m_options.unbuffered_output && is_concat(expression)) {
+            // no need to join the pieces when they can each go straight into the output buffer
+            const size_t count = push_pieces(expression);
+            m_code.emit("call", { "_print_n" });
+            pop_pieces(count);
+            return;
+        }
+        // _print copies the string into the output buffer, so it can go as soon as that is done
+        const bool temporary = allocates_string(expression);
+        if (temporary) {
+            heap_mark();
+        }
+
+        if (direct_num(expression)) {
+            generate_num(expression);
+            m_code.emit("call", { "_itoa" });
+            m_code.emit("mov", { "rsi", "rax" });
+        }
+        else if (type == Node::VariableType::STR) {
+            generate_expression(expression);
+            // Stack has: [Length, Pointer]
+            // We pop in reverse order of the push
+            stack_pop("rsi"); // Pop Pointer into RSI (address of string)
+            stack_pop("rdx"); // Pop Length into RDX (count of bytes)
+        }
+        else {
+            generate_expression(expression);
+            // Stack has: [Integer Value]
+            stack_pop("rax");
+            m_code.emit("call", { "_itoa" });
+            m_code.emit("mov", { "rsi", "rax" });
+            m_code.emit("mov", { "rdx", "rdx" });
+        }
+
+        m_code.emit("call", { m_options.unbuffered_output ? "_write" : "_print" });
+        if (temporary) {
+            heap_release();
+        }
+    }
+
+    void generate_let(const Node::Id let)
+    {
+        const std::string_view name = m_ast->token(let).value.value();
+        const Symbol symbol = m_ast->token(let).symbol;
+        // a let in an inner scope shadows an outer one of the same name until the inner scope ends
+        if (m_variables.declared_in_scope(symbol)) {
+            m_diagnostics->error(m_ast->position(let), "ya reusin variables ya bitch", name.length());
+        }
+        m_code.comment("generate variable");
+        const Node::Id expression = m_ast->lhs(let);
+        const Node::VariableType type = m_ast->type(expression);
+        std::optional<std::string_view> reg;
+        if (const auto allocated = m_registers.find(let);
+            allocated != m_registers.end() && type == Node::VariableType::NUM) {
+            reg = allocated->second;
+        }
+        // the value lands in the slot on top of the stack, but the name only means the new variable once the value
+        // is there: in `let x = x + 1;` the x on the right is still the shadowed one
+        const size_t stack_loc = m_stack_counter;
+        if (reg.has_value()) {
+            generate_num_into(reg.value(), expression);
+        }
+        else if (direct_num(expression)) {
+            generate_num(expression);
+            stack_push("rax");
+        }
+        else {
+            generate_expression(expression);
+        }
+        m_variables.declare(
+            symbol,
             {
-                assert(false && "not implemented");
-            };
-        };
+                .mutable_ = m_ast->is_mutable(let),
+                .stack_loc = stack_loc,
+                .type = type,
+                .reg = reg,
+            });
+    }
+
+    void generate_assignment(const Node::Id assignment)
+    {
+        const std::string_view name = m_ast->token(assignment).value.value();
+        const Variable* variable = m_variables.find(m_ast->token(assignment).symbol);
+        const size_t position = m_ast->position(assignment);
+        if (variable == nullptr) {
+            m_diagnostics->error(position, "ya usin imaginary variables ya ugly piece of shit", name.length());
+            return;
+        }
+
+        if (!variable->mutable_) {
+            m_diagnostics->error(position, "ya messign with an immutable variable you dingus", name.length());
+            return;
+        }
+        const Node::Id expression = m_ast->lhs(assignment);
+        if (variable->type != m_ast->type(expression)) {
+            m_diagnostics->error(position, "ya cannot reassign types, dingus", name.length());
+            return;
+        }
+        m_code.comment("reassign variable");
+        if (variable->reg.has_value()) {
+            generate_num_into(variable->reg.value(), expression);
+            return;
+        }
+        if (direct_num(expression)) {
+            generate_num(expression);
+            m_code.emit("mov", { variable_slot(*variable), "rax" });
+            return;
+        }
+        generate_expression(expression);
+        if (variable->type == Node::VariableType::STR) {
+            // Pop the new fat pointer (ptr, then len)
+            stack_pop("rax"); // new ptr
+            stack_pop("rbx"); // new len
+
+            m_code.emit("mov", { variable_slot(*variable), "rbx" });
+            m_code.emit("mov", { variable_slot(*variable, 1), "rax" });
+        }
+        else {
+            stack_pop("rax");
+            m_code.emit("mov", { variable_slot(*variable), "rax" });
+        }
+    }
+
+    void generate_if(const Node::Id if_node)
+    {
+        const Node::IfParts parts = m_ast->if_parts(if_node);
+        Node::VariableType type = m_ast->type(parts.condition);
+        if (direct_num(parts.condition)) {
+            generate_num(parts.condition);
+        }
+        else if (type == Node::VariableType::STR) {
+            const bool temporary = allocates_string(parts.condition);
+            if (temporary) {
+                heap_mark();
+            }
+            generate_expression(parts.condition);
+            // Stack has: [Length, Pointer]
+            stack_pop("rax"); // Pop the pointer (we don't need it for truthiness)
+            stack_pop("rax"); // Pop the length into RAX
+            if (temporary) {
+                heap_release();
+            }
+        }
+        else {
+            generate_expression(parts.condition);
+            // Stack has: [Integer]
+            stack_pop("rax");
+        }
+        auto elselabel = create_label();
+        auto skiplabel = create_label();
+        m_code.emit("test", { "rax", "rax" });
+        if (parts.else_ != Node::None) {
+            m_code.comment("jump to else");
+            m_code.emit("jz", { elselabel });
+        }
+        else {
+            m_code.comment("jump to skip");
+            m_code.emit("jz", { skiplabel });
+        }
+        m_code.comment("inside if");
+        generate_scope(parts.scope);
+        m_code.emit("jmp", { skiplabel });
+
+        if (parts.else_ != Node::None) {
+            m_code.label(elselabel);
+            m_code.comment("inside else");
+            if (m_ast->kind(parts.else_) == Node::Kind::Scope) {
+                generate_scope(parts.else_);
+            }
+            else {
+                generate_if(parts.else_);
+            }
+            m_code.emit("jmp", { skiplabel });
+        }
 
-        StatementVisitor visitor = { .generator = *this };
-        std::visit(visitor, statement->statement);
+        m_code.label(skiplabel);
+        m_code.comment("outside if-elif chain");
+    }
+
+    void generate_while(const Node::Id while_node)
+    {
+        const Node::Id condition = m_ast->lhs(while_node);
+        Node::VariableType type = m_ast->type(condition);
+        auto conditionlabel = create_label();
+        m_code.label(conditionlabel);
+        if (direct_num(condition)) {
+            generate_num(condition);
+        }
+        else if (type == Node::VariableType::STR) {
+            const bool temporary = allocates_string(condition);
+            if (temporary) {
+                heap_mark();
+            }
+            generate_expression(condition);
+            // Stack has: [Length, Pointer]
+            stack_pop("rax"); // Pop the pointer (we don't need it for truthiness)
+            stack_pop("rax"); // Pop the length into RAX
+            if (temporary) {
+                heap_release();
+            }
+        }
+        else {
+            generate_expression(condition);
+            // Stack has: [Integer]
+            stack_pop("rax");
+        }
+        auto skiplabel = create_label();
+        m_code.emit("test", { "rax", "rax" });
+        m_code.comment("jump to skip");
+        m_code.emit("jz", { skiplabel });
+        m_code.comment("inside while");
+        generate_scope(m_ast->rhs(while_node));
+        m_code.emit("jmp", { conditionlabel });
+
+        m_code.label(skiplabel);
+        m_code.comment("outside while loop");
     }
 
     struct Variable {
-        std::string name;
         bool mutable_;
         size_t stack_loc;
         Node::VariableType type;
+        // set when -O1 keeps the variable in a register instead of its stack slot
+        std::optional<std::string_view> reg;
     };
+    static constexpr size_t NoString = SIZE_MAX;
+
     struct StringConstant {
         std::string label;
-        std::string value;
+        std::string_view value;
     };
 
+    // the stack slot holding a variable, or the second one of a str
+    std::string variable_slot(const Variable& variable, const size_t word = 0) const
+    {
+        return "QWORD [rsp + " + std::to_string((m_stack_counter - (variable.stack_loc + word) - 1) * 8) + "]";
+    }
+
     std::stringstream coutmap() const
     {
         std::stringstream out;
-        for (const Variable& variable : m_variables) {
-            out << "Variable name=" << variable.name << " value=" << variable.stack_loc
-                << " mutable=" << variable.mutable_ << " | ";
+        for (const auto& entry : m_variables.entries()) {
+            out << "Variable symbol=" << entry.symbol << " value=" << entry.value.stack_loc
+                << " mutable=" << entry.value.mutable_ << " | ";
         }
         return out;
     }
 
-    const Node::Program m_prog;
-    std::stringstream m_asmout;
+    const Node::Ast* m_ast;
+    X86::Code m_code;
     size_t m_stack_counter = 0;
-    std::vector<Variable> m_variables {};
+    SymbolTable<Variable> m_variables {};
     std::vector<StringConstant> m_strings {};
-    std::vector<size_t> m_scopes {};
-    ArenaAllocator* m_allocator;
+    // symbol of a literal -> its entry in m_strings
+    std::vector<size_t> m_string_index {};
+    Diagnostics* m_diagnostics;
+    GeneratorOptions m_options;
+    RegisterAllocator::Allocation m_registers {};
     int m_label_count = 0;
-};
\ No newline at end of file
+};
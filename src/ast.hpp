@@ -0,0 +1,342 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "./arena.hpp"
+#include "./tokenization.hpp"
+
+namespace Node {
+
+enum class VariableType { NUM, STR };
+
+inline VariableType tokenToDatatype(const Token& token, Diagnostics* diagnostics)
+{
+    if (token.value.value() == "str") {
+        return VariableType::STR;
+    }
+    else if (token.value.value() == "num") {
+        return VariableType::NUM;
+    }
+    else {
+        diagnostics->error(
+            token.position,
+            "datatype " + std::string(token.value.value_or("NIL")) + " not yet supported.",
+            token.value.value_or("").length());
+        return VariableType::NUM;
+    }
+}
+
+inline std::string_view datatype_name(const VariableType type)
+{
+    return type == VariableType::STR ? "str" : "num";
+}
+
+// index of a node in its Ast
+using Id = uint32_t;
+constexpr Id None = UINT32_MAX;
+
+// What the token, lhs and rhs of a node hold. A list is the range [lhs, rhs) of Ast::extra.
+enum class Kind : uint8_t {
+    // token: the literal
+    IntLiteral,
+    StrLiteral,
+    // token: the name
+    Identifier,
+    // token: `(`, lhs: the expression inside
+    Paren,
+    // token: the name, lhs..rhs: the arguments
+    Call,
+    // token: the operator, lhs and rhs: the operands
+    Operation,
+    // token: the keyword, lhs: the expression
+    Exit,
+    Print,
+    Return,
+    // token: the name, lhs: the expression, rhs: 1 for `let mut`
+    Let,
+    // token: the name, lhs: the expression
+    Assignment,
+    // token: `{`, lhs..rhs: the statements
+    Scope,
+    // token: `if`, lhs: the condition, rhs: extra[rhs] is the scope and extra[rhs + 1] the else, a Scope, an If or None
+    If,
+    // token: `while`, lhs: the condition, rhs: the scope
+    While,
+    // token: `fn`, lhs..rhs: the name's Identifier, the return type, the body and then the arguments
+    Function,
+    // token: the name, rhs: the datatype
+    Argument,
+    // lhs..rhs: the top level statements
+    Program,
+};
+
+struct IfParts {
+    Id condition;
+    Id scope;
+    Id else_;
+};
+
+struct FunctionParts {
+    Id name;
+    VariableType return_type;
+    Id scope;
+    std::span<const Id> arguments;
+};
+
+// The whole tree as parallel arrays indexed by node: what kind it is, which token it stands for and two 32-bit child
+// slots, plus the type the Analyzer gives it. Lists of children are runs of `extra`. Tokens live in a table of their
+// own, holding only the ones some node refers to. Children are indices rather than pointers, so growing an array never
+// invalidates a node. Every array is in the arena, so the whole tree is freed with it.
+class Ast {
+public:
+    explicit Ast(ArenaAllocator* arena)
+        : m_kinds(arena)
+        , m_tokens(arena)
+        , m_lhs(arena)
+        , m_rhs(arena)
+        , m_types(arena)
+        , m_token_table(arena)
+        , m_extra(arena)
+    {
+    }
+
+    Id add(const Kind kind, const uint32_t token, const Id lhs = None, const Id rhs = None)
+    {
+        m_kinds.push_back(kind);
+        m_tokens.push_back(token);
+        m_lhs.push_back(lhs);
+        m_rhs.push_back(rhs);
+        m_types.push_back(VariableType::NUM);
+        return static_cast<Id>(m_kinds.size() - 1);
+    }
+
+    uint32_t add_token(const Token& token)
+    {
+        m_token_table.push_back(token);
+        return static_cast<uint32_t>(m_token_table.size() - 1);
+    }
+
+    // copies `ids` to the end of extra and returns where they start
+    uint32_t add_list(const std::span<const Id> ids)
+    {
+        const auto start = static_cast<uint32_t>(m_extra.size());
+        for (const Id id : ids) {
+            m_extra.push_back(id);
+        }
+        return start;
+    }
+
+    void set_root(const Id program)
+    {
+        m_root = program;
+    }
+
+    // makes `node` a copy of `other`, children and type included
+    void replace(const Id node, const Id other)
+    {
+        m_kinds[node] = m_kinds[other];
+        m_tokens[node] = m_tokens[other];
+        m_lhs[node] = m_lhs[other];
+        m_rhs[node] = m_rhs[other];
+        m_types[node] = m_types[other];
+    }
+
+    // turns `node` into a leaf standing for `token`
+    void replace_with_leaf(const Id node, const Kind kind, const Token& token)
+    {
+        m_kinds[node] = kind;
+        m_tokens[node] = add_token(token);
+        m_lhs[node] = None;
+        m_rhs[node] = None;
+    }
+
+    void set_type(const Id node, const VariableType type)
+    {
+        m_types[node] = type;
+    }
+
+    [[nodiscard]] Id root() const
+    {
+        return m_root;
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_kinds.size();
+    }
+
+    [[nodiscard]] Kind kind(const Id node) const
+    {
+        return m_kinds[node];
+    }
+
+    [[nodiscard]] const Token& token(const Id node) const
+    {
+        return m_token_table[m_tokens[node]];
+    }
+
+    // byte offset into the source, resolved through SourceMap when reporting
+    [[nodiscard]] size_t position(const Id node) const
+    {
+        return token(node).position;
+    }
+
+    [[nodiscard]] Id lhs(const Id node) const
+    {
+        return m_lhs[node];
+    }
+
+    [[nodiscard]] Id rhs(const Id node) const
+    {
+        return m_rhs[node];
+    }
+
+    [[nodiscard]] VariableType type(const Id node) const
+    {
+        return m_types[node];
+    }
+
+    // the children of a Scope, Call or Program
+    [[nodiscard]] std::span<const Id> list(const Id node) const
+    {
+        return { m_extra.data() + m_lhs[node], m_extra.data() + m_rhs[node] };
+    }
+
+    [[nodiscard]] IfParts if_parts(const Id node) const
+    {
+        return { .condition = m_lhs[node], .scope = m_extra[m_rhs[node]], .else_ = m_extra[m_rhs[node] + 1] };
+    }
+
+    [[nodiscard]] FunctionParts function_parts(const Id node) const
+    {
+        const uint32_t start = m_lhs[node];
+        return {
+            .name = m_extra[start],
+            .return_type = static_cast<VariableType>(m_extra[start + 1]),
+            .scope = m_extra[start + 2],
+            .arguments = { m_extra.data() + start + 3, m_extra.data() + m_rhs[node] },
+        };
+    }
+
+    [[nodiscard]] bool is_mutable(const Id let) const
+    {
+        return m_rhs[let] != 0;
+    }
+
+    [[nodiscard]] VariableType datatype(const Id argument) const
+    {
+        return static_cast<VariableType>(m_rhs[argument]);
+    }
+
+private:
+    ArenaVector<Kind> m_kinds;
+    ArenaVector<uint32_t> m_tokens;
+    ArenaVector<Id> m_lhs;
+    ArenaVector<Id> m_rhs;
+    // filled in by the Analyzer
+    ArenaVector<VariableType> m_types;
+    ArenaVector<Token> m_token_table;
+    ArenaVector<Id> m_extra;
+    Id m_root = None;
+};
+
+inline void dump_node(const Ast& ast, const Id node, const size_t depth, std::string& out)
+{
+    out.append(depth * 4, ' ');
+    const auto children = [&](const std::span<const Id> ids) {
+        for (const Id id : ids) {
+            dump_node(ast, id, depth + 1, out);
+        }
+    };
+    const auto child = [&](const Id id) { dump_node(ast, id, depth + 1, out); };
+    const auto spelling = [&] { return std::string(ast.token(node).value.value_or("")); };
+    switch (ast.kind(node)) {
+    case Kind::IntLiteral:
+        out += "IntLiteral " + spelling() + "\n";
+        break;
+    case Kind::StrLiteral:
+        out += "StrLiteral \"" + spelling() + "\"\n";
+        break;
+    case Kind::Identifier:
+        out += "Identifier " + spelling() + "\n";
+        break;
+    case Kind::Paren:
+        out += "Paren\n";
+        child(ast.lhs(node));
+        break;
+    case Kind::Call:
+        out += "Call " + spelling() + "\n";
+        children(ast.list(node));
+        break;
+    case Kind::Operation:
+        out += "Operation " + spelling() + "\n";
+        child(ast.lhs(node));
+        child(ast.rhs(node));
+        break;
+    case Kind::Exit:
+        out += "Exit\n";
+        child(ast.lhs(node));
+        break;
+    case Kind::Print:
+        out += "Print\n";
+        child(ast.lhs(node));
+        break;
+    case Kind::Return:
+        out += "Return\n";
+        child(ast.lhs(node));
+        break;
+    case Kind::Let:
+        out += std::string(ast.is_mutable(node) ? "Let mut " : "Let ") + spelling() + "\n";
+        child(ast.lhs(node));
+        break;
+    case Kind::Assignment:
+        out += "Assignment " + spelling() + "\n";
+        child(ast.lhs(node));
+        break;
+    case Kind::Scope:
+        out += "Scope\n";
+        children(ast.list(node));
+        break;
+    case Kind::If: {
+        const IfParts parts = ast.if_parts(node);
+        out += "If\n";
+        child(parts.condition);
+        child(parts.scope);
+        if (parts.else_ != None) {
+            child(parts.else_);
+        }
+        break;
+    }
+    case Kind::While:
+        out += "While\n";
+        child(ast.lhs(node));
+        child(ast.rhs(node));
+        break;
+    case Kind::Function: {
+        const FunctionParts parts = ast.function_parts(node);
+        out += "Function " + std::string(ast.token(parts.name).value.value()) + " "
+            + std::string(datatype_name(parts.return_type)) + "\n";
+        children(parts.arguments);
+        child(parts.scope);
+        break;
+    }
+    case Kind::Argument:
+        out += "Argument " + spelling() + " " + std::string(datatype_name(ast.datatype(node))) + "\n";
+        break;
+    case Kind::Program:
+        out += "Program\n";
+        children(ast.list(node));
+        break;
+    }
+}
+
+// the tree one node per line, children indented under their parent
+inline std::string dump(const Ast& ast)
+{
+    std::string out;
+    dump_node(ast, ast.root(), 0, out);
+    return out;
+}
+
+}
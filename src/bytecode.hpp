@@ -0,0 +1,580 @@
+#pragma once
+
+#include "./diagnostics.hpp"
+#include "./parser.hpp"
+#include "./symbols.hpp"
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A flat register bytecode for the VM, compiled straight from the checked-and-folded AST.
+//
+// Every instruction is the same 16 bytes: an opcode and three 32-bit operands, which are registers, indexes into the
+// constant pools or jump targets (instruction indexes), depending on the opcode. A register holds a num or a str (a
+// pointer and a length); which one is known when compiling, so the opcode says it and the VM never checks. Variables
+// own a register for their scope, temporaries are handed out above them and given back after every statement. A
+// literal used as an operand gets a register of its own past all of those, loaded once before the first statement, so
+// a loop does not reload its constants every time around.
+namespace Bytecode {
+
+enum class Op : uint32_t {
+    Num, // a = numbers[b]
+    Str, // a = strings[b]
+    Move, // a = b
+    Add, // a = b + c, and the same for Sub, Mul and Div. div by 0 raises SIGFPE like the native code does
+    Sub,
+    Mul,
+    Div,
+    ConcatStrStr, // a = b ++ c
+    ConcatStrNum, // a = b ++ c spelled out in decimal
+    ConcatNumStr,
+    PrintNum, // write a to stdout
+    PrintStr,
+    Mark, // a = the top of the string heap
+    Release, // free every string made since the Mark that wrote a
+    Jump, // to a
+    JumpIfZero, // to b if the num in a is 0
+    JumpIfEmpty, // to b if the str in a is empty
+    Exit, // end with status a
+};
+
+struct Instruction {
+    Op op;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t c = 0;
+};
+
+struct Program {
+    std::vector<Instruction> code;
+    std::vector<uint64_t> numbers;
+    // escapes already turned into the bytes they stand for
+    std::vector<std::string> strings;
+    uint32_t registers = 0;
+};
+
+inline std::string_view op_name(const Op op)
+{
+    switch (op) {
+    case Op::Num:
+        return "num";
+    case Op::Str:
+        return "str";
+    case Op::Move:
+        return "move";
+    case Op::Add:
+        return "add";
+    case Op::Sub:
+        return "sub";
+    case Op::Mul:
+        return "mul";
+    case Op::Div:
+        return "div";
+    case Op::ConcatStrStr:
+        return "concat.ss";
+    case Op::ConcatStrNum:
+        return "concat.sn";
+    case Op::ConcatNumStr:
+        return "concat.ns";
+    case Op::PrintNum:
+        return "print.n";
+    case Op::PrintStr:
+        return "print.s";
+    case Op::Mark:
+        return "mark";
+    case Op::Release:
+        return "release";
+    case Op::Jump:
+        return "jmp";
+    case Op::JumpIfZero:
+        return "jz";
+    case Op::JumpIfEmpty:
+        return "jempty";
+    case Op::Exit:
+        return "exit";
+    }
+    return "?";
+}
+
+// one instruction per line, `  12  add r3, r1, r2`
+inline std::string dump(const Program& program)
+{
+    std::stringstream out;
+    out << "; " << program.registers << " registers\n";
+    for (size_t i = 0; i < program.code.size(); i++) {
+        const Instruction& instruction = program.code[i];
+        out << (i < 10 ? "   " : i < 100 ? "  " : " ") << i << "  " << op_name(instruction.op);
+        const auto reg = [](const uint32_t index) { return "r" + std::to_string(index); };
+        switch (instruction.op) {
+        case Op::Num:
+            out << " " << reg(instruction.a) << ", " << program.numbers.at(instruction.b);
+            break;
+        case Op::Str: {
+            out << " " << reg(instruction.a) << ", \"";
+            for (const char c : program.strings.at(instruction.b)) {
+                out << (c == '\n' ? "\\n" : c == '\t' ? "\\t" : c == '\r' ? "\\r" : std::string(1, c));
+            }
+            out << "\"";
+            break;
+        }
+        case Op::Move:
+            out << " " << reg(instruction.a) << ", " << reg(instruction.b);
+            break;
+        case Op::PrintNum:
+        case Op::PrintStr:
+        case Op::Mark:
+        case Op::Release:
+        case Op::Exit:
+            out << " " << reg(instruction.a);
+            break;
+        case Op::Jump:
+            out << " " << instruction.a;
+            break;
+        case Op::JumpIfZero:
+        case Op::JumpIfEmpty:
+            out << " " << reg(instruction.a) << ", " << instruction.b;
+            break;
+        default:
+            out << " " << reg(instruction.a) << ", " << reg(instruction.b) << ", " << reg(instruction.c);
+            break;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
+
+// the bytes a literal stands for, with the escapes process_escape_sequences knows. any other backslash stays as it is.
+inline std::string unescape(const std::string_view literal)
+{
+    std::string result;
+    result.reserve(literal.length());
+    for (size_t i = 0; i < literal.length(); i++) {
+        if (literal[i] != '\\' || i + 1 == literal.length()) {
+            result += literal[i];
+            continue;
+        }
+        switch (literal[i + 1]) {
+        case 'n':
+            result += '\n';
+            break;
+        case 't':
+            result += '\t';
+            break;
+        case 'r':
+            result += '\r';
+            break;
+        case '"':
+            result += '"';
+            break;
+        case '\\':
+            result += '\\';
+            break;
+        default:
+            result += '\\';
+            continue;
+        }
+        i++;
+    }
+    return result;
+}
+
+// Compiles the AST into a Program, reporting the same semantic errors AssGenerator and IR::Lowering do.
+class Compiler {
+public:
+    explicit Compiler(Diagnostics* diagnostics)
+        : m_diagnostics(diagnostics)
+    {
+    }
+
+    Program compile(const Node::Ast& ast)
+    {
+        m_ast = &ast;
+        for (const Node::Id statement : ast.list(ast.root())) {
+            compile_statement(statement);
+        }
+        emit({ .op = Op::Exit, .a = constant(Op::Num, number(0)) });
+        place_constants();
+        return std::move(m_program);
+    }
+
+private:
+    struct Variable {
+        uint32_t reg;
+        bool mutable_;
+        Node::VariableType type;
+    };
+
+    using Type = Node::VariableType;
+
+    size_t emit(const Instruction& instruction)
+    {
+        m_program.code.push_back(instruction);
+        return m_program.code.size() - 1;
+    }
+
+    [[nodiscard]] uint32_t here() const
+    {
+        return static_cast<uint32_t>(m_program.code.size());
+    }
+
+    uint32_t temporary()
+    {
+        m_program.registers = std::max(m_program.registers, m_next + 1);
+        return m_next++;
+    }
+
+    uint32_t number(const uint64_t value)
+    {
+        const auto [found, added] = m_number_index.try_emplace(value, m_program.numbers.size());
+        if (added) {
+            m_program.numbers.push_back(value);
+        }
+        return found->second;
+    }
+
+    // literals are interned, so one pool entry per symbol is enough
+    uint32_t string(const Symbol symbol, const std::string_view literal)
+    {
+        if (symbol >= m_string_index.size()) {
+            m_string_index.resize(symbol + 1, None);
+        }
+        if (m_string_index[symbol] == None) {
+            m_string_index[symbol] = static_cast<uint32_t>(m_program.strings.size());
+            m_program.strings.push_back(unescape(literal));
+        }
+        return m_string_index[symbol];
+    }
+
+    // the register that holds numbers[index] or strings[index] for the whole run, marked until place_constants knows
+    // where the constant registers start
+    uint32_t constant(const Op op, const uint32_t index)
+    {
+        std::vector<uint32_t>& constants = op == Op::Num ? m_number_constant : m_string_constant;
+        if (index >= constants.size()) {
+            constants.resize(index + 1, None);
+        }
+        if (constants[index] == None) {
+            constants[index] = static_cast<uint32_t>(m_constants.size());
+            m_constants.push_back({ .op = op, .b = index });
+        }
+        return Constant | constants[index];
+    }
+
+    // puts the constant registers after every other one and the loads that fill them in front of the code
+    void place_constants()
+    {
+        const uint32_t first = m_program.registers;
+        const auto shift = static_cast<uint32_t>(m_constants.size());
+        const auto resolve = [first](uint32_t& operand) {
+            if ((operand & Constant) != 0) {
+                operand = first + (operand & ~Constant);
+            }
+        };
+        for (Instruction& instruction : m_program.code) {
+            switch (instruction.op) {
+            case Op::Jump:
+                instruction.a += shift;
+                break;
+            case Op::JumpIfZero:
+            case Op::JumpIfEmpty:
+                resolve(instruction.a);
+                instruction.b += shift;
+                break;
+            case Op::PrintNum:
+            case Op::PrintStr:
+            case Op::Exit:
+                resolve(instruction.a);
+                break;
+            case Op::Add:
+            case Op::Sub:
+            case Op::Mul:
+            case Op::Div:
+            case Op::ConcatStrStr:
+            case Op::ConcatStrNum:
+            case Op::ConcatNumStr:
+                resolve(instruction.b);
+                resolve(instruction.c);
+                break;
+            default:
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < shift; i++) {
+            m_constants[i].a = first + i;
+        }
+        m_program.code.insert(m_program.code.begin(), m_constants.begin(), m_constants.end());
+        m_program.registers += shift;
+    }
+
+    // one that does not fit has been reported by the Analyzer
+    [[nodiscard]] uint64_t literal_value(const Node::Id int_literal) const
+    {
+        const std::string_view digits = m_ast->token(int_literal).value.value();
+        uint64_t value = 0;
+        std::from_chars(digits.data(), digits.data() + digits.length(), value);
+        return value;
+    }
+
+    // only a concatenation makes a new string, literals and variables already have theirs
+    [[nodiscard]] bool allocates(const Node::Id expression) const
+    {
+        if (m_ast->kind(expression) == Node::Kind::Paren) {
+            return allocates(m_ast->lhs(expression));
+        }
+        return m_ast->type(expression) == Type::STR && m_ast->kind(expression) == Node::Kind::Operation;
+    }
+
+    void compile_scope(const Node::Id scope)
+    {
+        const uint32_t base = m_next;
+        m_variables.begin_scope();
+        for (const Node::Id statement : m_ast->list(scope)) {
+            compile_statement(statement);
+        }
+        m_variables.end_scope();
+        m_next = base;
+    }
+
+    // jumps to the returned instruction's target when the condition is false, the caller patches it in
+    size_t compile_condition(const Node::Id expression)
+    {
+        const uint32_t base = m_next;
+        const bool strings = m_ast->type(expression) == Type::STR;
+        const bool temporary_string = allocates(expression);
+        const uint32_t mark = temporary_string ? temporary() : 0;
+        if (temporary_string) {
+            emit({ .op = Op::Mark, .a = mark });
+        }
+        const uint32_t value = compile_operand(expression);
+        if (temporary_string) {
+            // only the length decides, so the string itself can go before the jump
+            emit({ .op = Op::Release, .a = mark });
+        }
+        m_next = base;
+        return emit({ .op = strings ? Op::JumpIfEmpty : Op::JumpIfZero, .a = value });
+    }
+
+    void compile_statement(const Node::Id statement)
+    {
+        switch (m_ast->kind(statement)) {
+        case Node::Kind::Exit: {
+            const Node::Id expression = m_ast->lhs(statement);
+            const uint32_t base = m_next;
+            const uint32_t value = compile_operand(expression);
+            emit({ .op = Op::Exit, .a = value });
+            m_next = base;
+            break;
+        }
+        case Node::Kind::Print: {
+            const Node::Id expression = m_ast->lhs(statement);
+            const uint32_t base = m_next;
+            const bool strings = m_ast->type(expression) == Type::STR;
+            // print copies the string out, so whatever the expression allocated is garbage right after
+            const bool temporary_string = allocates(expression);
+            const uint32_t mark = temporary_string ? temporary() : 0;
+            if (temporary_string) {
+                emit({ .op = Op::Mark, .a = mark });
+            }
+            const uint32_t value = compile_operand(expression);
+            emit({ .op = strings ? Op::PrintStr : Op::PrintNum, .a = value });
+            if (temporary_string) {
+                emit({ .op = Op::Release, .a = mark });
+            }
+            m_next = base;
+            break;
+        }
+        case Node::Kind::Let: {
+            const Token& identifier = m_ast->token(statement);
+            const Node::Id expression = m_ast->lhs(statement);
+            if (m_variables.declared_in_scope(identifier.symbol)) {
+                m_diagnostics->error(
+                    identifier.position, "ya reusin variables ya bitch", identifier.value.value().length());
+            }
+            const uint32_t reg = temporary();
+            const uint32_t base = m_next;
+            compile_into(expression, reg);
+            m_next = base;
+            m_variables.declare(
+                identifier.symbol,
+                { .reg = reg, .mutable_ = m_ast->is_mutable(statement), .type = m_ast->type(expression) });
+            break;
+        }
+        case Node::Kind::Assignment: {
+            const Token& identifier = m_ast->token(statement);
+            const Node::Id expression = m_ast->lhs(statement);
+            const Variable* variable = m_variables.find(identifier.symbol);
+            const size_t length = identifier.value.value().length();
+            if (variable == nullptr) {
+                m_diagnostics->error(identifier.position, "ya usin imaginary variables ya ugly piece of shit", length);
+                break;
+            }
+            if (!variable->mutable_) {
+                m_diagnostics->error(identifier.position, "ya messign with an immutable variable you dingus", length);
+                break;
+            }
+            if (variable->type != m_ast->type(expression)) {
+                m_diagnostics->error(identifier.position, "ya cannot reassign types, dingus", length);
+                break;
+            }
+            const uint32_t base = m_next;
+            compile_into(expression, variable->reg);
+            m_next = base;
+            break;
+        }
+        case Node::Kind::Scope:
+            compile_scope(statement);
+            break;
+        case Node::Kind::If: {
+            std::vector<size_t> ends;
+            compile_if(statement, ends);
+            for (const size_t end : ends) {
+                m_program.code[end].a = here();
+            }
+            break;
+        }
+        case Node::Kind::While: {
+            const uint32_t top = here();
+            const size_t skip = compile_condition(m_ast->lhs(statement));
+            compile_scope(m_ast->rhs(statement));
+            emit({ .op = Op::Jump, .a = top });
+            m_program.code[skip].b = here();
+            break;
+        }
+        case Node::Kind::Function:
+            m_diagnostics->error(m_ast->position(statement), "fns aint a thing yet ya dreamer", 2);
+            break;
+        case Node::Kind::Return:
+            m_diagnostics->error(m_ast->position(statement), "return to where ya dreamer", 6);
+            break;
+        default:
+            assert(false && "not a statement");
+        }
+    }
+
+    // every arm but the last jumps past the whole chain once it is done, an else-if adds its arms to `ends`
+    void compile_if(const Node::Id if_node, std::vector<size_t>& ends)
+    {
+        const Node::IfParts parts = m_ast->if_parts(if_node);
+        const size_t skip = compile_condition(parts.condition);
+        compile_scope(parts.scope);
+        if (parts.else_ == Node::None) {
+            m_program.code[skip].b = here();
+            return;
+        }
+        ends.push_back(emit({ .op = Op::Jump }));
+        m_program.code[skip].b = here();
+        if (m_ast->kind(parts.else_) == Node::Kind::Scope) {
+            compile_scope(parts.else_);
+        }
+        else {
+            compile_if(parts.else_, ends);
+        }
+    }
+
+    // the register holding the value: the variable's own for a plain identifier, the constant's for a literal, a new
+    // temporary otherwise
+    uint32_t compile_operand(const Node::Id expression)
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::IntLiteral:
+            return constant(Op::Num, number(literal_value(expression)));
+        case Node::Kind::StrLiteral: {
+            const Token& token = m_ast->token(expression);
+            return constant(Op::Str, string(token.symbol, token.value.value()));
+        }
+        case Node::Kind::Identifier:
+            if (const Variable* variable = m_variables.find(m_ast->token(expression).symbol)) {
+                return variable->reg;
+            }
+            break;
+        case Node::Kind::Paren:
+            return compile_operand(m_ast->lhs(expression));
+        default:
+            break;
+        }
+        const uint32_t reg = temporary();
+        compile_into(expression, reg);
+        return reg;
+    }
+
+    // operands are all read before dst is written, so dst may be one of the variables the expression uses
+    void compile_into(const Node::Id expression, const uint32_t dst)
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::IntLiteral:
+            emit({ .op = Op::Num, .a = dst, .b = number(literal_value(expression)) });
+            break;
+        case Node::Kind::StrLiteral: {
+            const Token& token = m_ast->token(expression);
+            emit({ .op = Op::Str, .a = dst, .b = string(token.symbol, token.value.value()) });
+            break;
+        }
+        case Node::Kind::Identifier:
+            if (const Variable* variable = m_variables.find(m_ast->token(expression).symbol)) {
+                if (variable->reg != dst) {
+                    emit({ .op = Op::Move, .a = dst, .b = variable->reg });
+                }
+                break;
+            }
+            // already reported by the Analyzer
+            emit({ .op = Op::Num, .a = dst, .b = number(0) });
+            break;
+        case Node::Kind::Paren:
+            compile_into(m_ast->lhs(expression), dst);
+            break;
+        case Node::Kind::Call: {
+            const Token& name = m_ast->token(expression);
+            m_diagnostics->error(name.position, "fn calls aint a thing yet ya dreamer", name.value.value().length());
+            emit({ .op = Op::Num, .a = dst, .b = number(0) });
+            break;
+        }
+        case Node::Kind::Operation: {
+            const Node::Id left_hand = m_ast->lhs(expression);
+            const Node::Id right_hand = m_ast->rhs(expression);
+            const uint32_t left = compile_operand(left_hand);
+            const uint32_t right = compile_operand(right_hand);
+            const char op = m_ast->token(expression).value.value().front();
+            const bool left_str = m_ast->type(left_hand) == Type::STR;
+            const bool right_str = m_ast->type(right_hand) == Type::STR;
+            if ((left_str || right_str) && op != '+') {
+                m_diagnostics->error(
+                    m_ast->position(expression), "ya cannot perform " + std::string(1, op) + " on strings ya ass");
+            }
+            Op code = op == '+' ? Op::Add : op == '-' ? Op::Sub : op == '*' ? Op::Mul : Op::Div;
+            if (left_str || right_str) {
+                code = !right_str ? Op::ConcatStrNum : !left_str ? Op::ConcatNumStr : Op::ConcatStrStr;
+            }
+            emit({ .op = code, .a = dst, .b = left, .c = right });
+            break;
+        }
+        default:
+            assert(false && "not an expression");
+        }
+    }
+
+    static constexpr uint32_t None = UINT32_MAX;
+    // set on the operands that name a constant register
+    static constexpr uint32_t Constant = 1U << 31;
+
+    Diagnostics* m_diagnostics;
+    const Node::Ast* m_ast = nullptr;
+    Program m_program;
+    // the lowest register no variable or live temporary holds
+    uint32_t m_next = 0;
+    SymbolTable<Variable> m_variables {};
+    // symbol of a literal -> its entry in m_program.strings
+    std::vector<uint32_t> m_string_index {};
+    std::unordered_map<uint64_t, uint32_t> m_number_index {};
+    // the loads of the constant registers, and which one holds each entry of numbers and of strings
+    std::vector<Instruction> m_constants {};
+    std::vector<uint32_t> m_number_constant {};
+    std::vector<uint32_t> m_string_constant {};
+};
+
+}
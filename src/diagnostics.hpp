@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "./scan.hpp"
+
+// Maps byte offsets back to 1-based line:column. The newline index is only built the first time a diagnostic asks
+// for a location, so a clean compile never pays for it.
+class SourceMap {
+public:
+    explicit SourceMap(const std::string_view src)
+        : m_src(src)
+    {
+    }
+
+    [[nodiscard]] std::pair<size_t, size_t> locate(const size_t offset) const
+    {
+        index_lines();
+        const auto line = std::ranges::upper_bound(m_line_starts, offset) - m_line_starts.begin();
+        return { line, offset - m_line_starts.at(line - 1) + 1 };
+    }
+
+    // the text of a 1-based line, without its newline
+    [[nodiscard]] std::string_view line_text(const size_t line) const
+    {
+        index_lines();
+        const size_t start = m_line_starts.at(line - 1);
+        return m_src.substr(start, Scan::find(m_src, start, '\n') - start);
+    }
+
+    [[nodiscard]] std::stringstream current_position(const size_t offset, std::string prefix = "error at ") const
+    {
+        std::stringstream out;
+        const auto [line, column] = locate(offset);
+        out << prefix << line << ":" << column;
+        return out;
+    }
+
+private:
+    void index_lines() const
+    {
+        if (!m_line_starts.empty()) {
+            return;
+        }
+        m_line_starts.push_back(0);
+        for (size_t i = Scan::find(m_src, 0, '\n'); i < m_src.length(); i = Scan::find(m_src, i + 1, '\n')) {
+            m_line_starts.push_back(i + 1);
+        }
+    }
+
+    std::string_view m_src;
+    mutable std::vector<size_t> m_line_starts;
+};
+
+struct Diagnostic {
+    // byte offset and length of the offending source span
+    size_t position;
+    size_t length;
+    std::string message;
+};
+
+// Collects every error of a compile so they can all be reported at once instead of exiting on the first one.
+class Diagnostics {
+public:
+    explicit Diagnostics(const SourceMap* source_map)
+        : m_source_map(source_map)
+    {
+    }
+
+    void error(const size_t position, std::string message, const size_t length = 1)
+    {
+        m_errors.push_back({ .position = position, .length = length, .message = std::move(message) });
+    }
+
+    [[nodiscard]] bool has_errors() const
+    {
+        return !m_errors.empty();
+    }
+
+    [[nodiscard]] size_t error_count() const
+    {
+        return m_errors.size();
+    }
+
+    // prints each error with its line and the span underlined, in source order
+    void report(std::ostream& out) const
+    {
+        std::vector<const Diagnostic*> sorted;
+        for (const Diagnostic& diagnostic : m_errors) {
+            sorted.push_back(&diagnostic);
+        }
+        std::ranges::stable_sort(sorted, {}, &Diagnostic::position);
+        for (const Diagnostic* diagnostic : sorted) {
+            const auto [line, column] = m_source_map->locate(diagnostic->position);
+            const std::string_view text = m_source_map->line_text(line);
+            const size_t underline = std::clamp<size_t>(diagnostic->length, 1, text.length() + 1 - column + 1);
+            out << diagnostic->message << " " << m_source_map->current_position(diagnostic->position).str() << "\n";
+            out << "    " << text << "\n";
+            out << "    " << std::string(column - 1, ' ') << std::string(underline, '^') << "\n";
+        }
+    }
+
+private:
+    const SourceMap* m_source_map;
+    std::vector<Diagnostic> m_errors;
+};
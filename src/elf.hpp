@@ -0,0 +1,120 @@
+#pragma once
+
+#include "./encoder.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <elf.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writes an encoded Object as a static ELF64 executable, the file `ld` used to make.
+//
+// The ELF and program headers and the text share one read+execute segment loaded at Base. Data and bss follow in a
+// read+write segment on the next page, and the kernel zero fills bss past the end of the file. There are no section
+// headers, nothing that runs the file needs them.
+namespace Elf {
+
+constexpr uint64_t Base = 0x400000;
+constexpr uint64_t PageSize = 0x1000;
+
+inline uint64_t align_up(const uint64_t value, const uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// returns what went wrong, nothing when the executable was written
+inline std::vector<std::string> write_executable(X86::Object& object, const std::string& path)
+{
+    constexpr size_t Segments = 3;
+    const uint64_t text_offset = align_up(sizeof(Elf64_Ehdr) + Segments * sizeof(Elf64_Phdr), 16);
+    const uint64_t text_end = text_offset + object.text.size();
+    const uint64_t data_offset = align_up(text_end, 16);
+    // a segment's address and file offset agree modulo the page size
+    const uint64_t data_address = align_up(Base + text_end, PageSize) + data_offset % PageSize;
+    const X86::Layout layout {
+        .text = Base + text_offset,
+        .data = data_address,
+        .bss = align_up(data_address + object.data.size(), 16),
+    };
+
+    std::vector<std::string> problems = X86::link(object, layout);
+    const auto entry = X86::address(object, layout, object.entry);
+    if (!entry.has_value()) {
+        problems.push_back("no entry point " + object.entry);
+    }
+    if (!problems.empty()) {
+        return problems;
+    }
+
+    Elf64_Ehdr header {};
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_EXEC;
+    header.e_machine = EM_X86_64;
+    header.e_version = EV_CURRENT;
+    header.e_entry = entry.value();
+    header.e_phoff = sizeof(Elf64_Ehdr);
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_phentsize = sizeof(Elf64_Phdr);
+    header.e_phnum = Segments;
+
+    const std::array<Elf64_Phdr, Segments> segments { {
+        {
+            .p_type = PT_LOAD,
+            .p_flags = PF_R | PF_X,
+            .p_offset = 0,
+            .p_vaddr = Base,
+            .p_paddr = Base,
+            .p_filesz = text_end,
+            .p_memsz = text_end,
+            .p_align = PageSize,
+        },
+        {
+            .p_type = PT_LOAD,
+            .p_flags = PF_R | PF_W,
+            .p_offset = data_offset,
+            .p_vaddr = layout.data,
+            .p_paddr = layout.data,
+            .p_filesz = object.data.size(),
+            .p_memsz = layout.bss + object.bss_size - layout.data,
+            .p_align = PageSize,
+        },
+        // without it the kernel makes the stack executable
+        {
+            .p_type = PT_GNU_STACK,
+            .p_flags = PF_R | PF_W,
+            .p_align = 16,
+        },
+    } };
+
+    std::vector<char> image(data_offset + object.data.size());
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + sizeof(header), segments.data(), sizeof(segments));
+    std::memcpy(image.data() + text_offset, object.text.data(), object.text.size());
+    std::memcpy(image.data() + data_offset, object.data.data(), object.data.size());
+
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(image.data(), static_cast<std::streamsize>(image.size()));
+    output.close();
+    if (!output) {
+        return { "cannot write " + path };
+    }
+    std::error_code error;
+    std::filesystem::permissions(
+        path,
+        std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec | std::filesystem::perms::others_exec,
+        std::filesystem::perm_options::add,
+        error);
+    if (error) {
+        return { "cannot make " + path + " executable, " + error.message() };
+    }
+    return {};
+}
+
+}
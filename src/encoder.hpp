@@ -0,0 +1,1031 @@
+#pragma once
+
+#include "./x86.hpp"
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Machine code for X86::Code without nasm or ld.
+//
+// Encoder reads the NASM subset the generators and RuntimeHelper are written in: the .text, .data and .bss sections,
+// labels (.local ones belong to the label before them, as in NASM), db/resb/resq, and the instructions the code
+// generators, the peephole pass and the runtime use. Every instruction form has one fixed encoding, so one pass is
+// enough. A reference to a label is left in the Object as a fixup, and link() patches it once the sections have
+// addresses.
+namespace X86 {
+
+enum class Section {
+    Text,
+    Data,
+    Bss,
+};
+
+struct Fixup {
+    enum class Kind {
+        // symbol + addend - the address `end` ends up at: jumps, calls and [symbol] operands
+        Rel32,
+        // symbol + addend itself. the cpu sign extends it, so the address has to be below 2 GB
+        Abs32,
+    };
+
+    Kind kind;
+    // the 4 bytes to patch, in the text section
+    size_t offset;
+    // the end of the instruction they are in
+    size_t end;
+    std::string symbol;
+    int64_t addend;
+};
+
+struct Definition {
+    Section section;
+    size_t offset;
+};
+
+struct Object {
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+    size_t bss_size = 0;
+    std::unordered_map<std::string, Definition> symbols;
+    std::vector<Fixup> fixups;
+    // the symbol named by `global`, where execution starts
+    std::string entry;
+};
+
+// the addresses the sections of an Object are placed at
+struct Layout {
+    uint64_t text;
+    uint64_t data;
+    uint64_t bss;
+};
+
+inline std::optional<uint64_t> address(const Object& object, const Layout& layout, const std::string& symbol)
+{
+    const auto found = object.symbols.find(symbol);
+    if (found == object.symbols.end()) {
+        return {};
+    }
+    switch (found->second.section) {
+    case Section::Text:
+        return layout.text + found->second.offset;
+    case Section::Data:
+        return layout.data + found->second.offset;
+    case Section::Bss:
+        return layout.bss + found->second.offset;
+    }
+    return {};
+}
+
+// patches every fixup for the given placement, returns what could not be resolved
+inline std::vector<std::string> link(Object& object, const Layout& layout)
+{
+    std::vector<std::string> problems;
+    for (const Fixup& fixup : object.fixups) {
+        const auto target = address(object, layout, fixup.symbol);
+        if (!target.has_value()) {
+            problems.push_back("undefined symbol " + fixup.symbol);
+            continue;
+        }
+        int64_t value = static_cast<int64_t>(target.value()) + fixup.addend;
+        if (fixup.kind == Fixup::Kind::Rel32) {
+            value -= static_cast<int64_t>(layout.text + fixup.end);
+        }
+        if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max()) {
+            problems.push_back(fixup.symbol + " is out of 32-bit reach");
+            continue;
+        }
+        for (size_t i = 0; i < 4; i++) {
+            object.text.at(fixup.offset + i) = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8));
+        }
+    }
+    return problems;
+}
+
+class Encoder {
+public:
+    Object encode(const Code& code)
+    {
+        for (const Line& line : code.lines()) {
+            switch (line.kind) {
+            case Line::Kind::Instruction: {
+                std::vector<std::string_view> operands;
+                for (const Operand& operand : line.instruction.operands) {
+                    operands.emplace_back(operand.text);
+                }
+                instruction(line.instruction.opcode, operands);
+                break;
+            }
+            case Line::Kind::Label:
+                define(line.text);
+                break;
+            case Line::Kind::Comment:
+                break;
+            case Line::Kind::Raw:
+                raw(line.text);
+                break;
+            }
+        }
+        return std::move(m_object);
+    }
+
+    [[nodiscard]] const std::vector<std::string>& problems() const
+    {
+        return m_problems;
+    }
+
+private:
+    struct Value {
+        int64_t number = 0;
+        // empty for a plain number
+        std::string symbol;
+    };
+
+    struct Memory {
+        // register numbers, -1 when there is none
+        int base = -1;
+        int index = -1;
+        int scale = 1;
+        Value displacement;
+    };
+
+    struct Argument {
+        enum class Kind {
+            Register,
+            Immediate,
+            Memory,
+        };
+
+        Kind kind;
+        int reg = 0;
+        // the width of a register, or of a memory operand that says BYTE/WORD/DWORD/QWORD. 0 when unknown.
+        size_t bits = 0;
+        Value value;
+        Memory memory;
+
+        [[nodiscard]] bool is_register() const
+        {
+            return kind == Kind::Register;
+        }
+        [[nodiscard]] bool is_immediate() const
+        {
+            return kind == Kind::Immediate;
+        }
+        [[nodiscard]] bool is_memory() const
+        {
+            return kind == Kind::Memory;
+        }
+    };
+
+    static constexpr std::array<std::pair<std::string_view, int>, 8> Arithmetic { {
+        { "add", 0 },
+        { "or", 1 },
+        { "adc", 2 },
+        { "sbb", 3 },
+        { "and", 4 },
+        { "sub", 5 },
+        { "xor", 6 },
+        { "cmp", 7 },
+    } };
+
+    // the F6/F7 group
+    static constexpr std::array<std::pair<std::string_view, int>, 6> Unary { {
+        { "not", 2 },
+        { "neg", 3 },
+        { "mul", 4 },
+        { "imul", 5 },
+        { "div", 6 },
+        { "idiv", 7 },
+    } };
+
+    static constexpr std::array<std::pair<std::string_view, int>, 6> Shifts { {
+        { "rol", 0 },
+        { "ror", 1 },
+        { "shl", 4 },
+        { "sal", 4 },
+        { "shr", 5 },
+        { "sar", 7 },
+    } };
+
+    static constexpr std::array<std::pair<std::string_view, int>, 30> Conditions { {
+        { "jo", 0x0 },   { "jno", 0x1 },  { "jb", 0x2 },   { "jc", 0x2 },   { "jnae", 0x2 }, { "jae", 0x3 },
+        { "jnb", 0x3 },  { "jnc", 0x3 },  { "je", 0x4 },   { "jz", 0x4 },   { "jne", 0x5 },  { "jnz", 0x5 },
+        { "jbe", 0x6 },  { "jna", 0x6 },  { "ja", 0x7 },   { "jnbe", 0x7 }, { "js", 0x8 },   { "jns", 0x9 },
+        { "jp", 0xA },   { "jnp", 0xB },  { "jl", 0xC },   { "jnge", 0xC }, { "jge", 0xD },  { "jnl", 0xD },
+        { "jle", 0xE },  { "jng", 0xE },  { "jg", 0xF },   { "jnle", 0xF }, { "jpe", 0xA },  { "jpo", 0xB },
+    } };
+
+    // the number the cpu knows each of Registers64 by
+    static constexpr std::array<int, 16> Encoding { 0, 3, 1, 2, 6, 7, 5, 4, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+    template <size_t N>
+    static std::optional<int> find(const std::array<std::pair<std::string_view, int>, N>& table, std::string_view name)
+    {
+        for (const auto& [spelling, value] : table) {
+            if (spelling == name) {
+                return value;
+            }
+        }
+        return {};
+    }
+
+    static std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    // splits on `separator` outside of quotes
+    static std::vector<std::string_view> split(const std::string_view text, const char separator)
+    {
+        std::vector<std::string_view> parts;
+        char quote = 0;
+        size_t start = 0;
+        for (size_t i = 0; i < text.length(); i++) {
+            if (quote != 0) {
+                quote = text[i] == quote ? 0 : quote;
+            }
+            else if (text[i] == '"' || text[i] == '\'') {
+                quote = text[i];
+            }
+            else if (text[i] == separator) {
+                parts.push_back(trim(text.substr(start, i - start)));
+                start = i + 1;
+            }
+        }
+        parts.push_back(trim(text.substr(start)));
+        return parts;
+    }
+
+    static bool is_symbol_char(const char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$';
+    }
+
+    static bool fits_int8(const int64_t value)
+    {
+        return value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max();
+    }
+
+    static bool fits_int32(const int64_t value)
+    {
+        return value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+    }
+
+    void problem(const std::string& message)
+    {
+        m_problems.push_back(message);
+    }
+
+    // a label of the current section. `.name` is local to the last label without a dot, as in NASM.
+    void define(const std::string_view name)
+    {
+        const std::string full = qualify(name);
+        if (!name.starts_with('.')) {
+            m_scope = full;
+        }
+        const size_t offset = m_section == Section::Text ? m_object.text.size()
+            : m_section == Section::Data                 ? m_object.data.size()
+                                                         : m_object.bss_size;
+        if (!m_object.symbols.emplace(full, Definition { .section = m_section, .offset = offset }).second) {
+            problem("label " + full + " defined twice");
+        }
+    }
+
+    [[nodiscard]] std::string qualify(const std::string_view name) const
+    {
+        return name.starts_with('.') ? m_scope + std::string(name) : std::string(name);
+    }
+
+    // hand written assembler text, one statement per line
+    void raw(const std::string_view text)
+    {
+        size_t start = 0;
+        while (start < text.length()) {
+            size_t end = text.find('\n', start);
+            end = end == std::string_view::npos ? text.length() : end;
+            statement(text.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    void statement(std::string_view line)
+    {
+        // drop the comment, a `;` in a string is not one
+        char quote = 0;
+        for (size_t i = 0; i < line.length(); i++) {
+            if (quote != 0) {
+                quote = line[i] == quote ? 0 : quote;
+            }
+            else if (line[i] == '"' || line[i] == '\'') {
+                quote = line[i];
+            }
+            else if (line[i] == ';') {
+                line = line.substr(0, i);
+                break;
+            }
+        }
+        line = trim(line);
+        if (line.empty()) {
+            return;
+        }
+        size_t word_end = 0;
+        while (word_end < line.length() && is_symbol_char(line[word_end])) {
+            word_end++;
+        }
+        const std::string_view word = line.substr(0, word_end);
+        std::string_view rest = trim(line.substr(word_end));
+        if (rest.starts_with(':')) {
+            define(word);
+            statement(rest.substr(1));
+            return;
+        }
+        if (word == "section") {
+            if (rest == ".text") {
+                m_section = Section::Text;
+            }
+            else if (rest == ".data") {
+                m_section = Section::Data;
+            }
+            else if (rest == ".bss") {
+                m_section = Section::Bss;
+            }
+            else {
+                problem("unknown section " + std::string(rest));
+            }
+            return;
+        }
+        if (word == "global") {
+            m_object.entry = std::string(rest);
+            return;
+        }
+        if (is_data_directive(word)) {
+            data(word, rest);
+            return;
+        }
+        size_t second_end = 0;
+        while (second_end < rest.length() && is_symbol_char(rest[second_end])) {
+            second_end++;
+        }
+        if (is_data_directive(rest.substr(0, second_end))) {
+            // `name db ...` labels the data without a colon
+            define(word);
+            data(rest.substr(0, second_end), trim(rest.substr(second_end)));
+            return;
+        }
+        std::string opcode(word);
+        if (opcode == "rep") {
+            opcode += " " + std::string(rest);
+            rest = {};
+        }
+        std::vector<std::string_view> operands;
+        if (!rest.empty()) {
+            operands = split(rest, ',');
+        }
+        instruction(opcode, operands);
+    }
+
+    static bool is_data_directive(const std::string_view word)
+    {
+        return word == "db" || word == "dw" || word == "dd" || word == "dq" || word == "resb" || word == "resw"
+            || word == "resd" || word == "resq";
+    }
+
+    void data(const std::string_view directive, const std::string_view operands)
+    {
+        const size_t width = directive.ends_with('b') ? 1
+            : directive.ends_with('w')                ? 2
+            : directive.ends_with('d')                ? 4
+                                                      : 8;
+        if (directive.starts_with("res")) {
+            const auto count = parse_value(operands);
+            if (!count.has_value() || !count->symbol.empty()) {
+                problem("bad reservation " + std::string(operands));
+                return;
+            }
+            if (m_section == Section::Bss) {
+                m_object.bss_size += width * static_cast<size_t>(count->number);
+            }
+            else {
+                bytes().resize(bytes().size() + width * static_cast<size_t>(count->number));
+            }
+            return;
+        }
+        if (m_section == Section::Bss) {
+            problem("initialized data in .bss");
+            return;
+        }
+        for (const std::string_view item : split(operands, ',')) {
+            if (item.length() >= 2 && item.front() == '"' && item.back() == '"') {
+                // NASM strings take no escapes, the generators spell special characters as numbers
+                for (const char c : item.substr(1, item.length() - 2)) {
+                    bytes().push_back(static_cast<uint8_t>(c));
+                }
+                continue;
+            }
+            const auto value = parse_value(item);
+            if (!value.has_value() || !value->symbol.empty()) {
+                problem("bad data " + std::string(item));
+                continue;
+            }
+            for (size_t i = 0; i < width; i++) {
+                bytes().push_back(static_cast<uint8_t>(static_cast<uint64_t>(value->number) >> (i * 8)));
+            }
+        }
+    }
+
+    std::vector<uint8_t>& bytes()
+    {
+        return m_section == Section::Data ? m_object.data : m_object.text;
+    }
+
+    // one term of an expression: a number, a character or a symbol
+    std::optional<Value> parse_term(const std::string_view term) const
+    {
+        if (term.empty()) {
+            return {};
+        }
+        if (term.length() >= 3 && (term.front() == '\'' || term.front() == '"') && term.back() == term.front()) {
+            uint64_t value = 0;
+            const std::string_view characters = term.substr(1, term.length() - 2);
+            for (size_t i = 0; i < characters.length() && i < 8; i++) {
+                value |= uint64_t(static_cast<uint8_t>(characters[i])) << (i * 8);
+            }
+            return Value { .number = static_cast<int64_t>(value) };
+        }
+        if (std::isdigit(static_cast<unsigned char>(term.front()))) {
+            // too many digits wrap around, the way NASM truncates them
+            uint64_t value = 0;
+            const bool hex = term.starts_with("0x") || term.starts_with("0X");
+            for (const char c : term.substr(hex ? 2 : 0)) {
+                const int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                    : hex && std::isxdigit(static_cast<unsigned char>(c))    ? std::tolower(c) - 'a' + 10
+                                                                             : -1;
+                if (digit < 0) {
+                    return {};
+                }
+                value = value * (hex ? 16 : 10) + static_cast<uint64_t>(digit);
+            }
+            return Value { .number = static_cast<int64_t>(value) };
+        }
+        for (const char c : term) {
+            if (!is_symbol_char(c)) {
+                return {};
+            }
+        }
+        return Value { .symbol = qualify(term) };
+    }
+
+    // `term (+|- term)*`, with at most one symbol and that one added
+    std::optional<Value> parse_value(const std::string_view text) const
+    {
+        Value result;
+        for (const auto& [sign, term] : terms(text)) {
+            const auto value = parse_term(term);
+            if (!value.has_value()) {
+                return {};
+            }
+            if (!value->symbol.empty()) {
+                if (sign < 0 || !result.symbol.empty()) {
+                    return {};
+                }
+                result.symbol = value->symbol;
+            }
+            result.number += sign * value->number;
+        }
+        return result;
+    }
+
+    // the signed terms of a sum
+    static std::vector<std::pair<int64_t, std::string_view>> terms(const std::string_view text)
+    {
+        std::vector<std::pair<int64_t, std::string_view>> result;
+        int64_t sign = 1;
+        size_t start = 0;
+        char quote = 0;
+        for (size_t i = 0; i <= text.length(); i++) {
+            if (i < text.length() && quote != 0) {
+                quote = text[i] == quote ? 0 : quote;
+                continue;
+            }
+            if (i < text.length() && (text[i] == '\'' || text[i] == '"')) {
+                quote = text[i];
+                continue;
+            }
+            if (i < text.length() && text[i] != '+' && text[i] != '-') {
+                continue;
+            }
+            const std::string_view term = trim(text.substr(start, i - start));
+            if (!term.empty()) {
+                result.emplace_back(sign, term);
+                sign = 1;
+            }
+            if (i < text.length()) {
+                sign = text[i] == '-' ? -sign : sign;
+            }
+            start = i + 1;
+        }
+        return result;
+    }
+
+    std::optional<Argument> parse_argument(std::string_view text)
+    {
+        text = trim(text);
+        if (const auto reg = lookup_register(text)) {
+            return Argument { .kind = Argument::Kind::Register, .reg = Encoding.at(reg->index), .bits = reg->bits };
+        }
+        const size_t open = text.find('[');
+        if (open == std::string_view::npos) {
+            if (const auto value = parse_value(text)) {
+                return Argument { .kind = Argument::Kind::Immediate, .value = value.value() };
+            }
+            problem("cannot read operand " + std::string(text));
+            return {};
+        }
+        Argument argument { .kind = Argument::Kind::Memory };
+        const std::string_view size = trim(text.substr(0, open));
+        argument.bits = size == "BYTE" ? 8 : size == "WORD" ? 16 : size == "DWORD" ? 32 : size == "QWORD" ? 64 : 0;
+        if (argument.bits == 0 && !size.empty()) {
+            problem("unknown operand size " + std::string(size));
+            return {};
+        }
+        const size_t close = text.find(']', open);
+        if (close == std::string_view::npos) {
+            problem("unclosed memory operand " + std::string(text));
+            return {};
+        }
+        Memory& memory = argument.memory;
+        for (const auto& [sign, term] : terms(text.substr(open + 1, close - open - 1))) {
+            const size_t star = term.find('*');
+            const auto reg = lookup_register(trim(term.substr(0, star)));
+            if (reg.has_value() && reg->bits == 64 && sign > 0) {
+                const auto scale = star == std::string_view::npos ? std::optional<Value>(Value { .number = 1 })
+                                                                  : parse_term(trim(term.substr(star + 1)));
+                if (star == std::string_view::npos && memory.base < 0) {
+                    memory.base = Encoding.at(reg->index);
+                }
+                else if (memory.index < 0 && scale.has_value() && scale->symbol.empty()
+                         && (scale->number == 1 || scale->number == 2 || scale->number == 4 || scale->number == 8)) {
+                    memory.index = Encoding.at(reg->index);
+                    memory.scale = int(scale->number);
+                }
+                else {
+                    problem("bad address " + std::string(text));
+                    return {};
+                }
+                continue;
+            }
+            const auto value = parse_term(term);
+            if (!value.has_value() || (!value->symbol.empty() && (sign < 0 || !memory.displacement.symbol.empty()))) {
+                problem("bad address " + std::string(text));
+                return {};
+            }
+            if (!value->symbol.empty()) {
+                memory.displacement.symbol = value->symbol;
+            }
+            memory.displacement.number += sign * value->number;
+        }
+        if (memory.index == 4) {
+            problem("rsp cannot be an index " + std::string(text));
+            return {};
+        }
+        return argument;
+    }
+
+    void byte(const uint8_t value)
+    {
+        m_object.text.push_back(value);
+    }
+
+    void immediate(const size_t size, const Value& value)
+    {
+        if (!value.symbol.empty()) {
+            if (size != 4) {
+                problem("an address only fits a 32-bit immediate");
+            }
+            m_object.fixups.push_back(
+                {
+                    .kind = Fixup::Kind::Abs32,
+                    .offset = m_object.text.size(),
+                    .symbol = value.symbol,
+                    .addend = value.number,
+                });
+        }
+        for (size_t i = 0; i < size; i++) {
+            byte(value.symbol.empty() ? static_cast<uint8_t>(static_cast<uint64_t>(value.number) >> (i * 8)) : 0);
+        }
+    }
+
+    void rex(const bool wide, const int reg, const int index, const int base, const bool force)
+    {
+        const uint8_t prefix = 0x40 | (wide ? 8 : 0) | ((reg & 8) != 0 ? 4 : 0)
+            | (index >= 0 && (index & 8) != 0 ? 2 : 0) | (base >= 0 && (base & 8) != 0 ? 1 : 0);
+        if (prefix != 0x40 || force) {
+            byte(prefix);
+        }
+    }
+
+    // an instruction with a ModRM byte. `reg` is the register in its reg field, or the opcode extension, and `rm` the
+    // register or memory operand. `bits` is the operand size, which decides the 0x66 prefix and REX.W.
+    void modrm(
+        const size_t bits,
+        const std::initializer_list<uint8_t> opcode,
+        const int reg,
+        const bool reg_is_register,
+        const Argument& rm,
+        const size_t immediate_size = 0,
+        const Value* immediate_value = nullptr)
+    {
+        if (bits == 16) {
+            byte(0x66);
+        }
+        // spl, bpl, sil and dil only exist with a REX prefix, without one they mean ah, ch, dh and bh
+        const bool byte_registers = bits == 8
+            && ((reg_is_register && reg >= 4 && reg < 8) || (rm.is_register() && rm.reg >= 4 && rm.reg < 8));
+        if (rm.is_register()) {
+            rex(bits == 64, reg, -1, rm.reg, byte_registers);
+        }
+        else {
+            rex(bits == 64, reg, rm.memory.index, rm.memory.base, byte_registers);
+        }
+        for (const uint8_t code : opcode) {
+            byte(code);
+        }
+        const uint8_t field = static_cast<uint8_t>((reg & 7) << 3);
+        size_t relative = SIZE_MAX;
+        if (rm.is_register()) {
+            byte(0xC0 | field | (rm.reg & 7));
+        }
+        else {
+            const Memory& memory = rm.memory;
+            const Value& displacement = memory.displacement;
+            const uint8_t scale = memory.scale == 8 ? 3 : memory.scale == 4 ? 2 : memory.scale == 2 ? 1 : 0;
+            if (memory.base < 0 && memory.index < 0 && !displacement.symbol.empty()) {
+                // [symbol] is rip relative
+                byte(0x05 | field);
+                relative = m_object.fixups.size();
+                m_object.fixups.push_back(
+                    {
+                        .kind = Fixup::Kind::Rel32,
+                        .offset = m_object.text.size(),
+                        .symbol = displacement.symbol,
+                        .addend = displacement.number,
+                    });
+                immediate(4, { .number = 0 });
+            }
+            else if (memory.base < 0) {
+                // an absolute address, plus an index if there is one
+                byte(0x04 | field);
+                byte(static_cast<uint8_t>(scale << 6 | (memory.index < 0 ? 4 : memory.index & 7) << 3 | 5));
+                immediate(4, displacement);
+            }
+            else {
+                const bool symbol = !displacement.symbol.empty();
+                if (!symbol && !fits_int32(displacement.number)) {
+                    problem("displacement out of range");
+                }
+                const uint8_t mod = symbol                                             ? 0x80
+                    : displacement.number == 0 && (memory.base & 7) != 5 ? 0x00
+                    : fits_int8(displacement.number)                     ? 0x40
+                                                                         : 0x80;
+                if (memory.index >= 0 || (memory.base & 7) == 4) {
+                    byte(mod | field | 4);
+                    byte(static_cast<uint8_t>(scale << 6 | (memory.index < 0 ? 4 : memory.index & 7) << 3
+                                              | (memory.base & 7)));
+                }
+                else {
+                    byte(mod | field | (memory.base & 7));
+                }
+                if (mod == 0x40) {
+                    immediate(1, displacement);
+                }
+                else if (mod == 0x80) {
+                    immediate(4, displacement);
+                }
+            }
+        }
+        if (immediate_value != nullptr) {
+            immediate(immediate_size, *immediate_value);
+        }
+        if (relative != SIZE_MAX) {
+            m_object.fixups[relative].end = m_object.text.size();
+        }
+    }
+
+    // an instruction that adds the register number to its opcode byte: push, pop, mov reg, imm
+    void plus_register(const size_t bits, const uint8_t opcode, const int reg)
+    {
+        if (bits == 16) {
+            byte(0x66);
+        }
+        rex(bits == 64, 0, -1, reg, bits == 8 && reg >= 4 && reg < 8);
+        byte(static_cast<uint8_t>(opcode + (reg & 7)));
+    }
+
+    void branch(const std::initializer_list<uint8_t> opcode, const Argument& target)
+    {
+        if (!target.is_immediate() || target.value.symbol.empty()) {
+            problem("can only jump to labels");
+            return;
+        }
+        for (const uint8_t code : opcode) {
+            byte(code);
+        }
+        m_object.fixups.push_back(
+            {
+                .kind = Fixup::Kind::Rel32,
+                .offset = m_object.text.size(),
+                .end = m_object.text.size() + 4,
+                .symbol = target.value.symbol,
+                .addend = target.value.number,
+            });
+        immediate(4, { .number = 0 });
+    }
+
+    // the operand size of a two operand instruction: a register says, a memory operand may
+    size_t operand_bits(const std::vector<Argument>& arguments)
+    {
+        for (const Argument& argument : arguments) {
+            if (argument.is_register()) {
+                return argument.bits;
+            }
+        }
+        for (const Argument& argument : arguments) {
+            if (argument.is_memory() && argument.bits != 0) {
+                return argument.bits;
+            }
+        }
+        problem("operand size not specified");
+        return 64;
+    }
+
+    void instruction(const std::string_view opcode, const std::vector<std::string_view>& operands)
+    {
+        if (m_section != Section::Text) {
+            problem("instruction outside .text: " + std::string(opcode));
+            return;
+        }
+        std::vector<Argument> arguments;
+        for (const std::string_view operand : operands) {
+            const auto argument = parse_argument(operand);
+            if (!argument.has_value()) {
+                return;
+            }
+            arguments.push_back(argument.value());
+        }
+        const size_t count = arguments.size();
+
+        if (count == 0) {
+            if (opcode == "ret") {
+                byte(0xC3);
+            }
+            else if (opcode == "syscall") {
+                byte(0x0F);
+                byte(0x05);
+            }
+            else if (opcode == "rep movsb") {
+                byte(0xF3);
+                byte(0xA4);
+            }
+            else if (opcode == "movsb") {
+                byte(0xA4);
+            }
+            else if (opcode == "cqo") {
+                byte(0x48);
+                byte(0x99);
+            }
+            else if (opcode == "nop") {
+                byte(0x90);
+            }
+            else {
+                unsupported(opcode, operands);
+            }
+            return;
+        }
+
+        const Argument& first = arguments[0];
+        if (count == 1 && (opcode == "jmp" || opcode == "call")) {
+            branch({ opcode == "jmp" ? uint8_t(0xE9) : uint8_t(0xE8) }, first);
+            return;
+        }
+        if (const auto condition = find(Conditions, opcode); condition.has_value() && count == 1) {
+            branch({ 0x0F, static_cast<uint8_t>(0x80 + condition.value()) }, first);
+            return;
+        }
+        if (opcode == "push" && count == 1) {
+            if (first.is_register() && first.bits == 64) {
+                plus_register(32, 0x50, first.reg);
+            }
+            else if (first.is_immediate() && first.value.symbol.empty() && fits_int8(first.value.number)) {
+                byte(0x6A);
+                immediate(1, first.value);
+            }
+            else if (first.is_immediate()) {
+                byte(0x68);
+                immediate(4, first.value);
+            }
+            else if (first.is_memory()) {
+                modrm(32, { 0xFF }, 6, false, first);
+            }
+            else {
+                unsupported(opcode, operands);
+            }
+            return;
+        }
+        if (opcode == "pop" && count == 1) {
+            if (first.is_register() && first.bits == 64) {
+                plus_register(32, 0x58, first.reg);
+            }
+            else if (first.is_memory()) {
+                modrm(32, { 0x8F }, 0, false, first);
+            }
+            else {
+                unsupported(opcode, operands);
+            }
+            return;
+        }
+        if (const auto extension = find(Unary, opcode); extension.has_value() && count == 1 && !first.is_immediate()) {
+            const size_t bits = operand_bits(arguments);
+            modrm(bits, { bits == 8 ? uint8_t(0xF6) : uint8_t(0xF7) }, extension.value(), false, first);
+            return;
+        }
+        if ((opcode == "inc" || opcode == "dec") && count == 1 && !first.is_immediate()) {
+            const size_t bits = operand_bits(arguments);
+            modrm(bits, { bits == 8 ? uint8_t(0xFE) : uint8_t(0xFF) }, opcode == "inc" ? 0 : 1, false, first);
+            return;
+        }
+        if (count < 2 || first.is_immediate()) {
+            unsupported(opcode, operands);
+            return;
+        }
+
+        const Argument& second = arguments[1];
+        const size_t bits = operand_bits(arguments);
+        const bool fits_immediate = second.is_immediate() && second.value.symbol.empty();
+        if (const auto extension = find(Arithmetic, opcode); extension.has_value() && count == 2) {
+            const auto base = static_cast<uint8_t>(extension.value() * 8);
+            if (second.is_immediate() && bits == 8) {
+                modrm(bits, { 0x80 }, extension.value(), false, first, 1, &second.value);
+            }
+            else if (fits_immediate && fits_int8(second.value.number)) {
+                modrm(bits, { 0x83 }, extension.value(), false, first, 1, &second.value);
+            }
+            else if (second.is_immediate()) {
+                check_imm32(second.value);
+                modrm(bits, { 0x81 }, extension.value(), false, first, bits == 16 ? 2 : 4, &second.value);
+            }
+            else if (second.is_register()) {
+                modrm(bits, { static_cast<uint8_t>(base + (bits == 8 ? 0 : 1)) }, second.reg, true, first);
+            }
+            else if (first.is_register()) {
+                modrm(bits, { static_cast<uint8_t>(base + (bits == 8 ? 2 : 3)) }, first.reg, true, second);
+            }
+            else {
+                unsupported(opcode, operands);
+            }
+            return;
+        }
+        if (opcode == "mov" && count == 2) {
+            if (first.is_register() && fits_immediate) {
+                move_immediate(first, second.value);
+            }
+            else if (second.is_immediate()) {
+                if (bits != 8 && bits != 16) {
+                    check_imm32(second.value);
+                }
+                const size_t size = bits == 8 ? 1 : bits == 16 ? 2 : 4;
+                modrm(bits, { bits == 8 ? uint8_t(0xC6) : uint8_t(0xC7) }, 0, false, first, size, &second.value);
+            }
+            else if (second.is_register()) {
+                modrm(bits, { bits == 8 ? uint8_t(0x88) : uint8_t(0x89) }, second.reg, true, first);
+            }
+            else if (first.is_register()) {
+                modrm(bits, { bits == 8 ? uint8_t(0x8A) : uint8_t(0x8B) }, first.reg, true, second);
+            }
+            else {
+                unsupported(opcode, operands);
+            }
+            return;
+        }
+        if (opcode == "movzx" && count == 2 && first.is_register() && !second.is_immediate()) {
+            const size_t from = second.bits;
+            if (from != 8 && from != 16) {
+                unsupported(opcode, operands);
+                return;
+            }
+            if (from == 8 && second.is_register() && second.reg >= 4 && second.reg < 8) {
+                // movzx from sil and friends needs a REX prefix that the destination does not ask for
+                unsupported(opcode, operands);
+                return;
+            }
+            modrm(first.bits, { 0x0F, from == 8 ? uint8_t(0xB6) : uint8_t(0xB7) }, first.reg, true, second);
+            return;
+        }
+        if (opcode == "lea" && count == 2 && first.is_register() && second.is_memory()) {
+            modrm(first.bits, { 0x8D }, first.reg, true, second);
+            return;
+        }
+        if (opcode == "test" && count == 2) {
+            if (second.is_register()) {
+                modrm(bits, { bits == 8 ? uint8_t(0x84) : uint8_t(0x85) }, second.reg, true, first);
+            }
+            else if (second.is_immediate()) {
+                check_imm32(second.value);
+                const size_t size = bits == 8 ? 1 : bits == 16 ? 2 : 4;
+                modrm(bits, { bits == 8 ? uint8_t(0xF6) : uint8_t(0xF7) }, 0, false, first, size, &second.value);
+            }
+            else {
+                unsupported(opcode, operands);
+            }
+            return;
+        }
+        if (opcode == "imul" && first.is_register() && !second.is_immediate()) {
+            if (count == 2) {
+                modrm(bits, { 0x0F, 0xAF }, first.reg, true, second);
+                return;
+            }
+            const Argument& third = arguments[2];
+            if (count == 3 && third.is_immediate() && third.value.symbol.empty()) {
+                if (fits_int8(third.value.number)) {
+                    modrm(bits, { 0x6B }, first.reg, true, second, 1, &third.value);
+                }
+                else {
+                    check_imm32(third.value);
+                    modrm(bits, { 0x69 }, first.reg, true, second, bits == 16 ? 2 : 4, &third.value);
+                }
+                return;
+            }
+        }
+        if (const auto extension = find(Shifts, opcode); extension.has_value() && count == 2 && first.bits != 0) {
+            // the count says nothing about the size, only what is shifted does
+            const size_t width = first.bits;
+            if (fits_immediate) {
+                const uint8_t code = width == 8 ? 0xC0 : 0xC1;
+                modrm(width, { code }, extension.value(), false, first, 1, &second.value);
+                return;
+            }
+            if (second.is_register() && second.reg == 1 && second.bits == 8) {
+                modrm(width, { width == 8 ? uint8_t(0xD2) : uint8_t(0xD3) }, extension.value(), false, first);
+                return;
+            }
+        }
+        unsupported(opcode, operands);
+    }
+
+    void move_immediate(const Argument& reg, const Value& value)
+    {
+        const int64_t number = value.number;
+        if (reg.bits == 64 && number >= 0 && number <= int64_t(UINT32_MAX)) {
+            // writing the low half zeroes the rest, and is shorter
+            plus_register(32, 0xB8, reg.reg);
+            immediate(4, value);
+        }
+        else if (reg.bits == 64 && fits_int32(number)) {
+            modrm(64, { 0xC7 }, 0, false, reg, 4, &value);
+        }
+        else if (reg.bits == 64) {
+            plus_register(64, 0xB8, reg.reg);
+            immediate(8, value);
+        }
+        else {
+            plus_register(reg.bits, reg.bits == 8 ? 0xB0 : 0xB8, reg.reg);
+            immediate(reg.bits / 8, value);
+        }
+    }
+
+    void check_imm32(const Value& value)
+    {
+        if (value.symbol.empty() && !fits_int32(value.number)) {
+            problem("immediate " + std::to_string(value.number) + " does not fit in 32 bits");
+        }
+    }
+
+    void unsupported(const std::string_view opcode, const std::vector<std::string_view>& operands)
+    {
+        std::string text(opcode);
+        for (size_t i = 0; i < operands.size(); i++) {
+            text += (i == 0 ? " " : ", ") + std::string(operands[i]);
+        }
+        problem("cannot encode " + text);
+    }
+
+    Object m_object {};
+    Section m_section = Section::Text;
+    // the last label without a dot, the one .local labels belong to
+    std::string m_scope {};
+    std::vector<std::string> m_problems {};
+};
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using Symbol = uint32_t;
+
+// the symbol of a token with no interned spelling
+constexpr Symbol NoSymbol = UINT32_MAX;
+
+// Hands out a dense id per distinct spelling, 0, 1, 2, ... in order of first sight. One Interner lives for the whole
+// compile and the tokenizer interns every identifier and string literal into it, so two names or literals are the same
+// exactly when their symbols are equal and every later stage compares and indexes by integer rather than by string.
+class Interner {
+public:
+    Symbol intern(const std::string_view name)
+    {
+        if (const auto found = m_symbols.find(name); found != m_symbols.end()) {
+            return found->second;
+        }
+        const auto symbol = static_cast<Symbol>(m_names.size());
+        // a deque never moves its elements, so the map can key on views into them
+        const std::string& stored = m_names.emplace_back(name);
+        m_symbols.emplace(stored, symbol);
+        return symbol;
+    }
+
+    [[nodiscard]] std::string_view name(const Symbol symbol) const
+    {
+        return m_names.at(symbol);
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return m_names.size();
+    }
+
+private:
+    std::deque<std::string> m_names {};
+    std::unordered_map<std::string_view, Symbol> m_symbols {};
+};
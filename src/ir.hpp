@@ -0,0 +1,579 @@
+#pragma once
+
+#include "./diagnostics.hpp"
+#include "./parser.hpp"
+#include "./symbols.hpp"
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A typed, linear three-address IR between the AST and the backends.
+//
+// A program is one Function: a list of basic blocks over an unbounded set of virtual registers. Every vreg has a fixed
+// type, num (a 64-bit value) or str (a pointer and a length). Every block ends in exactly one terminator (jmp, br or
+// exit), so the control flow of if/else/while is explicit in the block edges. Variables are vregs that may be written
+// more than once, so this is not SSA; a pass that wants SSA can rename on top of it.
+namespace IR {
+
+using VReg = uint32_t;
+using BlockId = uint32_t;
+constexpr VReg NoReg = UINT32_MAX;
+constexpr BlockId NoBlock = UINT32_MAX;
+
+enum class Type { Num, Str };
+
+enum class Op {
+    Const, // dst = imm
+    Str, // dst = string literal `text`, escapes still verbatim
+    Copy, // dst = a
+    Add, // dst = a + b, and the same for Sub, Mul and Div
+    Sub,
+    Mul,
+    Div,
+    Concat, // dst = a ++ b, a num side is spelled out in decimal
+    Print, // write a to stdout
+    // terminators
+    Jump, // to targets[0]
+    Branch, // to targets[0] if a is truthy (non-zero num, non-empty str), else to targets[1]
+    Exit, // end the process with status a
+};
+
+struct Instruction {
+    Op op;
+    VReg dst = NoReg;
+    std::array<VReg, 2> args { NoReg, NoReg };
+    uint64_t imm = 0;
+    std::string_view text;
+    std::array<BlockId, 2> targets { 0, 0 };
+
+    [[nodiscard]] bool is_terminator() const
+    {
+        return op == Op::Jump || op == Op::Branch || op == Op::Exit;
+    }
+};
+
+struct Block {
+    std::vector<Instruction> instructions;
+
+    [[nodiscard]] bool terminated() const
+    {
+        return !instructions.empty() && instructions.back().is_terminator();
+    }
+
+    [[nodiscard]] std::vector<BlockId> successors() const
+    {
+        if (!terminated()) {
+            return {};
+        }
+        const Instruction& last = instructions.back();
+        if (last.op == Op::Jump) {
+            return { last.targets[0] };
+        }
+        if (last.op == Op::Branch) {
+            return { last.targets[0], last.targets[1] };
+        }
+        return {};
+    }
+};
+
+struct Function {
+    std::vector<Block> blocks;
+    std::vector<Type> types;
+
+    VReg new_vreg(const Type type)
+    {
+        types.push_back(type);
+        return static_cast<VReg>(types.size() - 1);
+    }
+
+    BlockId new_block()
+    {
+        blocks.emplace_back();
+        return static_cast<BlockId>(blocks.size() - 1);
+    }
+};
+
+inline std::string_view op_name(const Op op)
+{
+    switch (op) {
+    case Op::Const:
+        return "const";
+    case Op::Str:
+        return "str";
+    case Op::Copy:
+        return "copy";
+    case Op::Add:
+        return "add";
+    case Op::Sub:
+        return "sub";
+    case Op::Mul:
+        return "mul";
+    case Op::Div:
+        return "div";
+    case Op::Concat:
+        return "concat";
+    case Op::Print:
+        return "print";
+    case Op::Jump:
+        return "jmp";
+    case Op::Branch:
+        return "br";
+    case Op::Exit:
+        return "exit";
+    }
+    return "?";
+}
+
+// one instruction per line, `%3:num = add %1, %2`, blocks headed by `bbN:` with their predecessors
+inline std::string dump(const Function& function)
+{
+    std::vector<std::vector<BlockId>> predecessors(function.blocks.size());
+    for (BlockId id = 0; id < function.blocks.size(); id++) {
+        for (const BlockId successor : function.blocks[id].successors()) {
+            if (successor < predecessors.size()) {
+                predecessors[successor].push_back(id);
+            }
+        }
+    }
+    const auto vreg = [&](const VReg reg) {
+        std::stringstream out;
+        out << "%" << reg;
+        if (reg < function.types.size()) {
+            out << (function.types[reg] == Type::Num ? ":num" : ":str");
+        }
+        return out.str();
+    };
+    std::stringstream out;
+    for (BlockId id = 0; id < function.blocks.size(); id++) {
+        out << "bb" << id << ":";
+        if (!predecessors[id].empty()) {
+            out << " ; preds";
+            for (const BlockId predecessor : predecessors[id]) {
+                out << " bb" << predecessor;
+            }
+        }
+        out << "\n";
+        for (const Instruction& instruction : function.blocks[id].instructions) {
+            out << "    ";
+            if (instruction.dst != NoReg) {
+                out << vreg(instruction.dst) << " = ";
+            }
+            out << op_name(instruction.op);
+            switch (instruction.op) {
+            case Op::Const:
+                out << " " << instruction.imm;
+                break;
+            case Op::Str:
+                out << " \"" << instruction.text << "\"";
+                break;
+            case Op::Jump:
+                out << " bb" << instruction.targets[0];
+                break;
+            case Op::Branch:
+                out << " " << vreg(instruction.args[0]) << ", bb" << instruction.targets[0] << ", bb"
+                    << instruction.targets[1];
+                break;
+            default:
+                for (size_t i = 0; i < instruction.args.size() && instruction.args[i] != NoReg; i++) {
+                    out << (i == 0 ? " " : ", ") << vreg(instruction.args[i]);
+                }
+                break;
+            }
+            out << "\n";
+        }
+    }
+    return out.str();
+}
+
+// Checks the structural rules every pass may rely on and returns one message per violation, empty when the function is
+// well formed: blocks end in exactly one terminator, edges point at blocks that exist, every vreg operand exists and
+// is written somewhere, and operand types fit the opcode.
+inline std::vector<std::string> verify(const Function& function)
+{
+    std::vector<std::string> problems;
+    std::vector<bool> written(function.types.size(), false);
+    for (const Block& block : function.blocks) {
+        for (const Instruction& instruction : block.instructions) {
+            if (instruction.dst < written.size()) {
+                written[instruction.dst] = true;
+            }
+        }
+    }
+    for (BlockId id = 0; id < function.blocks.size(); id++) {
+        const Block& block = function.blocks[id];
+        const auto problem = [&](const size_t index, const std::string& message) {
+            problems.push_back("bb" + std::to_string(id) + "[" + std::to_string(index) + "]: " + message);
+        };
+        if (!block.terminated()) {
+            problem(block.instructions.size(), "block does not end in a terminator");
+        }
+        for (size_t i = 0; i < block.instructions.size(); i++) {
+            const Instruction& instruction = block.instructions[i];
+            if (instruction.is_terminator() && i + 1 != block.instructions.size()) {
+                problem(i, std::string(op_name(instruction.op)) + " in the middle of a block");
+            }
+            size_t arity = 0;
+            bool has_dst = true;
+            switch (instruction.op) {
+            case Op::Const:
+            case Op::Str:
+                break;
+            case Op::Copy:
+                arity = 1;
+                break;
+            case Op::Add:
+            case Op::Sub:
+            case Op::Mul:
+            case Op::Div:
+            case Op::Concat:
+                arity = 2;
+                break;
+            case Op::Print:
+            case Op::Branch:
+            case Op::Exit:
+                arity = 1;
+                has_dst = false;
+                break;
+            case Op::Jump:
+                has_dst = false;
+                break;
+            }
+            if (has_dst != (instruction.dst != NoReg) || (has_dst && instruction.dst >= function.types.size())) {
+                problem(i, "bad destination");
+                continue;
+            }
+            bool operands_ok = true;
+            for (size_t a = 0; a < instruction.args.size(); a++) {
+                const VReg arg = instruction.args[a];
+                const bool expected = a < arity;
+                const bool present = arg != NoReg;
+                if (expected != present || (present && (arg >= function.types.size() || !written[arg]))) {
+                    problem(i, "bad operand " + std::to_string(a));
+                    operands_ok = false;
+                }
+            }
+            if (!operands_ok) {
+                continue;
+            }
+            const auto type = [&](const VReg reg) { return function.types[reg]; };
+            bool types_ok = true;
+            switch (instruction.op) {
+            case Op::Const:
+                types_ok = type(instruction.dst) == Type::Num;
+                break;
+            case Op::Str:
+                types_ok = type(instruction.dst) == Type::Str;
+                break;
+            case Op::Copy:
+                types_ok = type(instruction.dst) == type(instruction.args[0]);
+                break;
+            case Op::Add:
+            case Op::Sub:
+            case Op::Mul:
+            case Op::Div:
+                types_ok = type(instruction.dst) == Type::Num && type(instruction.args[0]) == Type::Num
+                    && type(instruction.args[1]) == Type::Num;
+                break;
+            case Op::Concat:
+                types_ok = type(instruction.dst) == Type::Str;
+                break;
+            case Op::Exit:
+                types_ok = type(instruction.args[0]) == Type::Num;
+                break;
+            default:
+                break;
+            }
+            if (!types_ok) {
+                problem(i, "operand types do not fit " + std::string(op_name(instruction.op)));
+            }
+            const size_t targets = instruction.op == Op::Jump ? 1 : instruction.op == Op::Branch ? 2 : 0;
+            for (size_t t = 0; t < targets; t++) {
+                if (instruction.targets[t] >= function.blocks.size()) {
+                    problem(i, "edge to missing block bb" + std::to_string(instruction.targets[t]));
+                }
+            }
+        }
+    }
+    return problems;
+}
+
+// Lowers the checked-and-folded AST into a Function, reporting the same semantic errors AssGenerator does.
+class Lowering {
+public:
+    explicit Lowering(Diagnostics* diagnostics)
+        : m_diagnostics(diagnostics)
+    {
+    }
+
+    Function lower(const Node::Ast& ast)
+    {
+        m_ast = &ast;
+        m_current = m_function.new_block();
+        for (const Node::Id statement : ast.list(ast.root())) {
+            lower_statement(statement);
+        }
+        if (!current().terminated()) {
+            const VReg zero = emit_const(0);
+            emit({ .op = Op::Exit, .args = { zero, NoReg } });
+        }
+        return std::move(m_function);
+    }
+
+private:
+    struct Variable {
+        VReg reg;
+        bool mutable_;
+    };
+
+    Block& current()
+    {
+        return m_function.blocks[m_current];
+    }
+
+    // code after a terminator (a statement following exit) lands in a fresh block nothing jumps to
+    void emit(const Instruction& instruction)
+    {
+        if (current().terminated()) {
+            m_current = m_function.new_block();
+        }
+        current().instructions.push_back(instruction);
+    }
+
+    VReg emit_const(const uint64_t value)
+    {
+        const VReg dst = m_function.new_vreg(Type::Num);
+        emit({ .op = Op::Const, .dst = dst, .imm = value });
+        return dst;
+    }
+
+    void jump(const BlockId target)
+    {
+        emit({ .op = Op::Jump, .targets = { target, 0 } });
+    }
+
+    // a vreg is only ever bound to one variable, and one whose scope has ended can no longer be named, so having been
+    // bound is as good as being bound now
+    [[nodiscard]] bool is_variable(const VReg reg) const
+    {
+        return reg < m_bound.size() && m_bound[reg];
+    }
+
+    void lower_scope(const Node::Id scope)
+    {
+        m_variables.begin_scope();
+        for (const Node::Id statement : m_ast->list(scope)) {
+            lower_statement(statement);
+        }
+        m_variables.end_scope();
+    }
+
+    void lower_statement(const Node::Id statement)
+    {
+        switch (m_ast->kind(statement)) {
+        case Node::Kind::Exit: {
+            const VReg value = lower_expression(m_ast->lhs(statement));
+            emit({ .op = Op::Exit, .args = { value, NoReg } });
+            break;
+        }
+        case Node::Kind::Print: {
+            const VReg value = lower_expression(m_ast->lhs(statement));
+            emit({ .op = Op::Print, .args = { value, NoReg } });
+            break;
+        }
+        case Node::Kind::Let:
+            lower_let(statement);
+            break;
+        case Node::Kind::Assignment:
+            lower_assignment(statement);
+            break;
+        case Node::Kind::Scope:
+            lower_scope(statement);
+            break;
+        case Node::Kind::If:
+            m_current = lower_if(statement, NoBlock);
+            break;
+        case Node::Kind::While: {
+            const BlockId header = m_function.new_block();
+            const BlockId body = m_function.new_block();
+            const BlockId exit = m_function.new_block();
+            jump(header);
+
+            m_current = header;
+            const VReg condition = lower_expression(m_ast->lhs(statement));
+            emit({ .op = Op::Branch, .args = { condition, NoReg }, .targets = { body, exit } });
+
+            m_current = body;
+            lower_scope(m_ast->rhs(statement));
+            jump(header);
+
+            m_current = exit;
+            break;
+        }
+        case Node::Kind::Function:
+            m_diagnostics->error(m_ast->position(statement), "fns aint a thing yet ya dreamer", 2);
+            break;
+        case Node::Kind::Return:
+            m_diagnostics->error(m_ast->position(statement), "return to where ya dreamer", 6);
+            break;
+        default:
+            assert(false && "not a statement");
+        }
+    }
+
+    void lower_let(const Node::Id let_node)
+    {
+        const Token& identifier = m_ast->token(let_node);
+        const std::string_view name = identifier.value.value();
+        const Symbol symbol = identifier.symbol;
+        if (m_variables.declared_in_scope(symbol)) {
+            m_diagnostics->error(identifier.position, "ya reusin variables ya bitch", name.length());
+        }
+        VReg value = lower_expression(m_ast->lhs(let_node));
+        if (is_variable(value)) {
+            // `let y = x;` must not alias x, which can still change
+            const VReg copy = m_function.new_vreg(m_function.types[value]);
+            emit({ .op = Op::Copy, .dst = copy, .args = { value, NoReg } });
+            value = copy;
+        }
+        m_variables.declare(symbol, { .reg = value, .mutable_ = m_ast->is_mutable(let_node) });
+        if (value >= m_bound.size()) {
+            m_bound.resize(value + 1);
+        }
+        m_bound[value] = true;
+    }
+
+    void lower_assignment(const Node::Id assign_node)
+    {
+        const Token& identifier = m_ast->token(assign_node);
+        const std::string_view name = identifier.value.value();
+        const Variable* variable = m_variables.find(identifier.symbol);
+        if (variable == nullptr) {
+            m_diagnostics->error(
+                identifier.position, "ya usin imaginary variables ya ugly piece of shit", name.length());
+            return;
+        }
+        if (!variable->mutable_) {
+            m_diagnostics->error(
+                identifier.position, "ya messign with an immutable variable you dingus", name.length());
+            return;
+        }
+        const VReg target = variable->reg;
+        const VReg value = lower_expression(m_ast->lhs(assign_node));
+        if (m_function.types[value] != m_function.types[target]) {
+            m_diagnostics->error(identifier.position, "ya cannot reassign types, dingus", name.length());
+            return;
+        }
+        // a fresh temporary is renamed into the variable rather than copied
+        std::vector<Instruction>& instructions = current().instructions;
+        if (!is_variable(value) && !instructions.empty() && instructions.back().dst == value) {
+            instructions.back().dst = target;
+            return;
+        }
+        emit({ .op = Op::Copy, .dst = target, .args = { value, NoReg } });
+    }
+
+    // each arm jumps to the merge block, created after the first arms so blocks come out in source order.
+    // an else-if chains into the else block of the one before it and shares its merge block.
+    BlockId lower_if(const Node::Id if_node, BlockId merge)
+    {
+        const Node::IfParts parts = m_ast->if_parts(if_node);
+        const VReg condition = lower_expression(parts.condition);
+        const BlockId then_block = m_function.new_block();
+        const BlockId else_block = parts.else_ != Node::None ? m_function.new_block() : NoBlock;
+        if (merge == NoBlock) {
+            merge = m_function.new_block();
+        }
+        emit(
+            {
+                .op = Op::Branch,
+                .args = { condition, NoReg },
+                .targets = { then_block, else_block == NoBlock ? merge : else_block },
+            });
+
+        m_current = then_block;
+        lower_scope(parts.scope);
+        jump(merge);
+
+        if (parts.else_ != Node::None) {
+            m_current = else_block;
+            if (m_ast->kind(parts.else_) == Node::Kind::Scope) {
+                lower_scope(parts.else_);
+                jump(merge);
+            }
+            else {
+                lower_if(parts.else_, merge);
+            }
+        }
+        return merge;
+    }
+
+    // returns the vreg holding the value, which is the variable's own vreg for a plain identifier
+    VReg lower_expression(const Node::Id expression)
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::IntLiteral: {
+            // one that does not fit has been reported by the Analyzer
+            const std::string_view digits = m_ast->token(expression).value.value();
+            uint64_t value = 0;
+            std::from_chars(digits.data(), digits.data() + digits.length(), value);
+            return emit_const(value);
+        }
+        case Node::Kind::StrLiteral: {
+            const VReg dst = m_function.new_vreg(Type::Str);
+            emit({ .op = Op::Str, .dst = dst, .text = m_ast->token(expression).value.value() });
+            return dst;
+        }
+        case Node::Kind::Identifier: {
+            if (const Variable* variable = m_variables.find(m_ast->token(expression).symbol)) {
+                return variable->reg;
+            }
+            // already reported by the Analyzer
+            return emit_const(0);
+        }
+        case Node::Kind::Paren:
+            return lower_expression(m_ast->lhs(expression));
+        case Node::Kind::Call: {
+            const Token& name = m_ast->token(expression);
+            m_diagnostics->error(name.position, "fn calls aint a thing yet ya dreamer", name.value.value().length());
+            return emit_const(0);
+        }
+        case Node::Kind::Operation: {
+            const VReg left = lower_expression(m_ast->lhs(expression));
+            const VReg right = lower_expression(m_ast->rhs(expression));
+            const char op = m_ast->token(expression).value.value().front();
+            const bool strings = m_function.types[left] == Type::Str || m_function.types[right] == Type::Str;
+            if (strings && op != '+') {
+                m_diagnostics->error(
+                    m_ast->position(expression), "ya cannot perform " + std::string(1, op) + " on strings ya ass");
+            }
+            if (strings) {
+                const VReg dst = m_function.new_vreg(Type::Str);
+                emit({ .op = Op::Concat, .dst = dst, .args = { left, right } });
+                return dst;
+            }
+            const VReg dst = m_function.new_vreg(Type::Num);
+            const Op code = op == '+' ? Op::Add : op == '-' ? Op::Sub : op == '*' ? Op::Mul : Op::Div;
+            emit({ .op = code, .dst = dst, .args = { left, right } });
+            return dst;
+        }
+        default:
+            assert(false && "not an expression");
+            return emit_const(0);
+        }
+    }
+
+    Diagnostics* m_diagnostics;
+    const Node::Ast* m_ast = nullptr;
+    Function m_function;
+    BlockId m_current = 0;
+    SymbolTable<Variable> m_variables {};
+    // indexed by vreg
+    std::vector<bool> m_bound {};
+};
+
+}
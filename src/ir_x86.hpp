@@ -0,0 +1,163 @@
+#pragma once
+
+#include "./assembly.hpp"
+#include "./ir.hpp"
+#include "./x86.hpp"
+#include <string>
+#include <vector>
+
+namespace IR {
+
+// Straightforward x86-64 backend for the IR: every vreg gets a fixed slot in one frame reserved on entry (16 bytes for
+// a str, pointer then length), and each instruction loads its operands, computes, and stores the result. rsp never
+// moves after the prologue, so slots are plain [rsp + offset]. Shares RuntimeHelper with AssGenerator.
+class X86Backend {
+public:
+    explicit X86Backend(const Function* function, GeneratorOptions options = {})
+        : m_function(function)
+        , m_options(options)
+    {
+    }
+
+    X86::Code generate()
+    {
+        size_t frame = 0;
+        for (const Type type : m_function->types) {
+            m_slots.push_back(frame);
+            frame += type == Type::Str ? 16 : 8;
+        }
+        frame = (frame + 15) & ~size_t(15);
+
+        m_code.raw("global _start\n");
+        m_code.label("_start");
+        if (frame > 0) {
+            m_code.emit("sub", { "rsp", std::to_string(frame) });
+        }
+        for (BlockId id = 0; id < m_function->blocks.size(); id++) {
+            m_code.label(block_label(id));
+            for (const Instruction& instruction : m_function->blocks[id].instructions) {
+                generate_instruction(instruction, id);
+            }
+        }
+        if (!m_strings.empty()) {
+            m_code.raw("section .data\n");
+        }
+        for (size_t i = 0; i < m_strings.size(); i++) {
+            size_t length = 0;
+            const std::string processed = process_escape_sequences(m_strings[i], length);
+            m_code.raw("    irstr_" + std::to_string(i) + " db \"" + processed + "\", 0\n");
+        }
+        m_code.raw(RuntimeHelper + "\n");
+        return std::move(m_code);
+    }
+
+private:
+    static std::string block_label(const BlockId id)
+    {
+        return "bb" + std::to_string(id);
+    }
+
+    // the first qword of a vreg's slot: the value of a num, the pointer of a str
+    std::string slot(const VReg reg, const size_t word = 0) const
+    {
+        return "QWORD [rsp + " + std::to_string(m_slots[reg] + word * 8) + "]";
+    }
+
+    bool is_str(const VReg reg) const
+    {
+        return m_function->types[reg] == Type::Str;
+    }
+
+    // a str operand as pointer/length in the given registers, a num one spelled out by _itoa first
+    void load_string(const VReg reg, const std::string_view ptr, const std::string_view len)
+    {
+        if (is_str(reg)) {
+            m_code.emit("mov", { ptr, slot(reg) });
+            m_code.emit("mov", { len, slot(reg, 1) });
+            return;
+        }
+        m_code.emit("mov", { "rax", slot(reg) });
+        m_code.emit("call", { "_itoa" });
+        m_code.emit("mov", { ptr, "rax" });
+        m_code.emit("mov", { len, "rdx" });
+    }
+
+    void generate_instruction(const Instruction& instruction, const BlockId block)
+    {
+        const VReg a = instruction.args[0];
+        const VReg b = instruction.args[1];
+        switch (instruction.op) {
+        case Op::Const:
+            m_code.emit("mov", { "rax", std::to_string(instruction.imm) });
+            m_code.emit("mov", { slot(instruction.dst), "rax" });
+            break;
+        case Op::Str: {
+            size_t length = 0;
+            process_escape_sequences(instruction.text, length);
+            m_code.emit("lea", { "rax", "[irstr_" + std::to_string(m_strings.size()) + "]" });
+            m_code.emit("mov", { slot(instruction.dst), "rax" });
+            m_code.emit("mov", { slot(instruction.dst, 1), std::to_string(length) });
+            m_strings.push_back(instruction.text);
+            break;
+        }
+        case Op::Copy:
+            m_code.emit("mov", { "rax", slot(a) });
+            m_code.emit("mov", { slot(instruction.dst), "rax" });
+            if (is_str(a)) {
+                m_code.emit("mov", { "rax", slot(a, 1) });
+                m_code.emit("mov", { slot(instruction.dst, 1), "rax" });
+            }
+            break;
+        case Op::Add:
+        case Op::Sub:
+        case Op::Mul:
+            m_code.emit("mov", { "rax", slot(a) });
+            m_code.emit(
+                instruction.op == Op::Add ? "add" : instruction.op == Op::Sub ? "sub" : "imul", { "rax", slot(b) });
+            m_code.emit("mov", { slot(instruction.dst), "rax" });
+            break;
+        case Op::Div:
+            m_code.emit("mov", { "rax", slot(a) });
+            m_code.emit("xor", { "edx", "edx" });
+            m_code.emit("div", { slot(b) });
+            m_code.emit("mov", { slot(instruction.dst), "rax" });
+            break;
+        case Op::Concat:
+            // _itoa hands out one shared buffer, but at most one side of a concat is a num
+            load_string(b, "r13", "r12");
+            load_string(a, "r15", "r14");
+            m_code.emit("call", { "_runtime_concat" });
+            m_code.emit("mov", { slot(instruction.dst), "rax" });
+            m_code.emit("mov", { slot(instruction.dst, 1), "rdx" });
+            break;
+        case Op::Print:
+            load_string(a, "rsi", "rdx");
+            m_code.emit("call", { m_options.unbuffered_output ? "_write" : "_print" });
+            break;
+        case Op::Jump:
+            if (instruction.targets[0] != block + 1) {
+                m_code.emit("jmp", { block_label(instruction.targets[0]) });
+            }
+            break;
+        case Op::Branch:
+            m_code.emit("cmp", { slot(a, is_str(a) ? 1 : 0), "0" });
+            m_code.emit("je", { block_label(instruction.targets[1]) });
+            if (instruction.targets[0] != block + 1) {
+                m_code.emit("jmp", { block_label(instruction.targets[0]) });
+            }
+            break;
+        case Op::Exit:
+            m_code.emit("mov", { "rdi", slot(a) });
+            m_code.emit("jmp", { "_exit" });
+            break;
+        }
+    }
+
+    const Function* m_function;
+    GeneratorOptions m_options;
+    X86::Code m_code;
+    std::vector<size_t> m_slots {};
+    std::vector<std::string_view> m_strings {};
+};
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "./elf.hpp"
+#include "./encoder.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+// Runs an encoded Object inside the compiler's own process, for `helium run`.
+//
+// The sections go into one anonymous mapping laid out the way write_executable lays out the file: text first, data on
+// the page after it, bss right behind data. MAP_32BIT keeps every address below 2 GB, which the Abs32 fixups need. Once
+// linked, text is made read+execute and control jumps to the entry. The program never comes back, its `_exit` ends the
+// process with sys_exit just like the executable would, so the exit code is the program's. load() stops short of the
+// jump, for callers that call into the code themselves, like the runtime's tests.
+namespace Jit {
+
+// an Object mapped and linked in memory, its text executable
+struct Image {
+    void* region = nullptr;
+    uint64_t size = 0;
+    X86::Layout layout {};
+};
+
+// returns what kept the object from loading, `image` is only filled in when nothing did
+inline std::vector<std::string> load(X86::Object& object, Image& image)
+{
+    const uint64_t text_size = Elf::align_up(object.text.size(), Elf::PageSize);
+    const uint64_t data_end = Elf::align_up(object.data.size(), 16);
+    const uint64_t size = text_size + Elf::align_up(data_end + object.bss_size, Elf::PageSize);
+
+    void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (region == MAP_FAILED) {
+        return { std::string("cannot map memory for the program, ") + std::strerror(errno) };
+    }
+    auto* base = static_cast<uint8_t*>(region);
+    const auto start = reinterpret_cast<uint64_t>(base);
+    const X86::Layout layout {
+        .text = start,
+        .data = start + text_size,
+        .bss = start + text_size + data_end,
+    };
+
+    std::vector<std::string> problems = X86::link(object, layout);
+    if (!problems.empty()) {
+        munmap(region, size);
+        return problems;
+    }
+
+    // the mapping is already zero, which covers bss
+    std::memcpy(base, object.text.data(), object.text.size());
+    std::memcpy(base + text_size, object.data.data(), object.data.size());
+    if (mprotect(region, text_size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(region, size);
+        return { std::string("cannot make the program executable, ") + std::strerror(errno) };
+    }
+    image = { .region = region, .size = size, .layout = layout };
+    return {};
+}
+
+// returns what kept the program from starting, it does not return at all once the program runs
+inline std::vector<std::string> run(X86::Object& object)
+{
+    Image image;
+    std::vector<std::string> problems = load(object, image);
+    if (!problems.empty()) {
+        return problems;
+    }
+    const auto entry = X86::address(object, image.layout, object.entry);
+    if (!entry.has_value()) {
+        munmap(image.region, image.size);
+        return { "no entry point " + object.entry };
+    }
+
+    // nothing of ours gets to run after this, so whatever we printed has to be out first
+    std::cout.flush();
+    std::cerr.flush();
+    reinterpret_cast<void (*)()>(entry.value())();
+    return { "the program came back, it was supposed to exit" };
+}
+
+}
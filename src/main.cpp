@@ -3,24 +3,26 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "./analyzer.hpp"
 #include "./arena.hpp"
 #include "./assembly.hpp"
+#include "./ast.hpp"
+#include "./bytecode.hpp"
+#include "./elf.hpp"
+#include "./encoder.hpp"
+#include "./interner.hpp"
+#include "./ir.hpp"
+#include "./ir_x86.hpp"
+#include "./jit.hpp"
+#include "./optimizer.hpp"
 #include "./parser.hpp"
+#include "./peephole.hpp"
+#include "./source.hpp"
 #include "./tokenization.hpp"
-
-std::string readFile(char* filepath)
-{
-    std::string contents;
-    {
-        std::stringstream codestream;
-        std::fstream input(filepath, std::ios::in);
-        codestream << input.rdbuf();
-        contents = codestream.str();
-    }
-    return contents;
-}
+#include "./vm.hpp"
 
 void writeFile(const std::string& filepath, const std::string* data)
 {
@@ -78,42 +80,243 @@ std::string generate_path(const PathSplit& path)
     return out.str();
 }
 
+struct Options {
+    std::string input;
+    std::string output;
+    GeneratorOptions generator;
+    // print the tree as parsed instead of compiling
+    bool emit_ast = false;
+    // print the IR instead of compiling, or compile through it
+    bool emit_ir = false;
+    bool via_ir = false;
+    // report what the optimizers did, and the arena's usage, on stderr
+    bool stats = false;
+    // write the assembly next to the output and build it with nasm and ld, instead of encoding it ourselves
+    bool emit_asm = false;
+    // `helium run`, execute the program in this process instead of writing an executable
+    bool run = false;
+    // `helium vm`, interpret the program's bytecode instead of compiling it to machine code, or print that bytecode
+    bool vm = false;
+    bool emit_bytecode = false;
+};
+
+void usage()
+{
+    std::cerr << "Incorrect Usage" << std::endl;
+    std::cerr << "Usage: `helium [-O0|-O1] [--ir] [--unbuffered] [--stats] [-S] <filepath.he> <outfile>`" << std::endl;
+    std::cerr << "       `helium --emit-ast <filepath.he>`" << std::endl;
+    std::cerr << "       `helium --emit-ir <filepath.he>`" << std::endl;
+    std::cerr << "       `helium run [-O0|-O1] [--ir] [--unbuffered] <filepath.he>` runs it without writing anything"
+              << std::endl;
+    std::cerr << "       `helium vm [--unbuffered] <filepath.he>` interprets it as bytecode" << std::endl;
+    std::cerr << "       `helium --emit-bytecode <filepath.he>` prints that bytecode" << std::endl;
+    std::cerr << "       pass `-` as the filepath to read the program from stdin" << std::endl;
+    std::cerr << "       -O1 keeps num variables in registers, -O0 (the default) keeps everything on the stack"
+              << std::endl;
+    std::cerr << "       --ir generates code from the IR, --emit-ir prints the IR to stdout" << std::endl;
+    std::cerr << "       --unbuffered makes every print write to stdout right away" << std::endl;
+    std::cerr << "       --stats reports how much the optimizers removed and how much memory the tree took"
+              << std::endl;
+    std::cerr << "       -S (or --emit-asm) writes <outfile>.asm and builds it with nasm and ld" << std::endl;
+}
+
+// flags may go anywhere, the two remaining arguments are the input and the output. a lone `-` is stdin, not a flag.
+std::optional<Options> parse_options(int argc, char** argv)
+{
+    Options options;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "-O0") {
+            options.generator.opt_level = 0;
+        }
+        else if (arg == "-O1") {
+            options.generator.opt_level = 1;
+        }
+        else if (arg == "--emit-ast") {
+            options.emit_ast = true;
+        }
+        else if (arg == "--emit-ir") {
+            options.emit_ir = true;
+        }
+        else if (arg == "--ir") {
+            options.via_ir = true;
+        }
+        else if (arg == "--unbuffered") {
+            options.generator.unbuffered_output = true;
+        }
+        else if (arg == "--stats") {
+            options.stats = true;
+        }
+        else if (arg == "--emit-bytecode") {
+            options.emit_bytecode = true;
+        }
+        else if (arg == "-S" || arg == "--emit-asm") {
+            options.emit_asm = true;
+        }
+        else if (arg.length() > 1 && arg.front() == '-') {
+            std::cerr << "wat flag is " << arg << " ya clown" << std::endl;
+            return {};
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+    if (!positional.empty() && positional.front() == "run") {
+        positional.erase(positional.begin());
+        if (positional.size() != 1 || options.emit_ast || options.emit_ir || options.emit_asm) {
+            return {};
+        }
+        options.run = true;
+    }
+    else if (!positional.empty() && positional.front() == "vm") {
+        positional.erase(positional.begin());
+        if (positional.size() != 1 || options.emit_ast || options.emit_ir || options.emit_asm
+            || options.emit_bytecode) {
+            return {};
+        }
+        options.vm = true;
+    }
+    else if (positional.size() != 2
+        && !((options.emit_ast || options.emit_ir || options.emit_bytecode) && positional.size() == 1)) {
+        return {};
+    }
+    options.input = positional.at(0);
+    if (positional.size() == 2) {
+        options.output = positional.at(1);
+    }
+    return options;
+}
+
 int main(int argc, char** argv)
 {
-    if (argc < 3) {
-        std::cerr << "Incorrect Usage" << std::endl;
-        std::cerr << "Usage: `helium <filepath.he> <outfile>`" << std::endl;
+    const std::optional<Options> options = parse_options(argc, argv);
+    if (!options.has_value()) {
+        usage();
         return EXIT_FAILURE;
     }
 
-    Tokenizer tokenizer(readFile(argv[1]));
+    SourceFile source(options->input);
+    SourceMap source_map(source.view());
+    Diagnostics diagnostics(&source_map);
+    // every identifier and string literal spelling, shared by all the stages below
+    Interner interner;
+    Tokenizer tokenizer(source.view(), &diagnostics, &interner);
+    TokenStream tokens(&tokenizer);
+    // the tree lives in the arena and goes with it
+    ArenaAllocator allocator;
+    Node::Ast ast(&allocator);
+    Parser parser(&tokens, &ast, &diagnostics);
+    parser.parse();
+
+    // codegen over a program with holes in it would only pile more errors on top of the syntax ones
+    if (diagnostics.has_errors()) {
+        diagnostics.report(std::cerr);
+        exit(EXIT_FAILURE);
+    }
+
+    if (options->emit_ast) {
+        std::cout << Node::dump(ast);
+        return EXIT_SUCCESS;
+    }
 
-    std::vector<Token> tokens = tokenizer.tokenize();
-    // for (Token token : tokens)
-    // {
-    //     std::cout << token.type << " : " << token.value.value_or("") << std::endl;
-    // }
-    ArenaAllocator allocator(1024 * 1024 * 4);
-    Parser parser(tokens, &allocator);
+    // errors found from here on are semantic, generation still runs to report as many of them as it can
+    Analyzer(&diagnostics).analyze(&ast);
 
-    std::optional<Node::Program> prog_node = parser.parse();
+    Optimizer optimizer(&allocator, &interner);
+    optimizer.optimize(&ast);
 
-    // std::cout << prog_node.value().to_string().str() << std::endl;
+    if (options->stats) {
+        std::cerr << "optimizer folded " << optimizer.folded() << " expressions" << std::endl;
+        const ArenaStats& arena = allocator.stats();
+        std::cerr << "arena used=" << arena.bytes_used << " reserved=" << arena.bytes_reserved
+                  << " blocks=" << arena.blocks << " waste=" << arena.waste << std::endl;
+    }
 
-    if (!prog_node.has_value()) {
-        std::cerr << "ya messed up ya twat" << std::endl;
+    if (options->vm || options->emit_bytecode) {
+        const Bytecode::Program program = Bytecode::Compiler(&diagnostics).compile(ast);
+        if (diagnostics.has_errors()) {
+            diagnostics.report(std::cerr);
+            exit(EXIT_FAILURE);
+        }
+        if (options->emit_bytecode) {
+            std::cout << Bytecode::dump(program);
+            return EXIT_SUCCESS;
+        }
+        return VM::run(program, options->generator.unbuffered_output);
+    }
+
+    X86::Code code;
+    if (options->emit_ir || options->via_ir) {
+        IR::Function function = IR::Lowering(&diagnostics).lower(ast);
+        if (diagnostics.has_errors()) {
+            diagnostics.report(std::cerr);
+            exit(EXIT_FAILURE);
+        }
+        const std::vector<std::string> problems = IR::verify(function);
+        for (const std::string& problem : problems) {
+            std::cerr << "me IR is broken, " << problem << std::endl;
+        }
+        if (!problems.empty()) {
+            exit(EXIT_FAILURE);
+        }
+        if (options->emit_ir) {
+            std::cout << IR::dump(function);
+            return EXIT_SUCCESS;
+        }
+        code = IR::X86Backend(&function, options->generator).generate();
+    }
+    else {
+        AssGenerator generator(&ast, &diagnostics, options->generator);
+        code = generator.generate_program();
+    }
+
+    if (diagnostics.has_errors()) {
+        diagnostics.report(std::cerr);
         exit(EXIT_FAILURE);
     }
 
-    AssGenerator generator(prog_node.value(), &allocator);
+    if (options->generator.opt_level >= 1) {
+        const size_t total = code.instruction_count();
+        const size_t removed = Peephole().run(code);
+        if (options->stats) {
+            std::cerr << "peephole removed " << removed << " of " << total << " instructions" << std::endl;
+        }
+    }
+    if (options->run) {
+        X86::Encoder encoder;
+        X86::Object object = encoder.encode(code);
+        const std::vector<std::string> problems = encoder.problems();
+        for (const std::string& problem : problems) {
+            std::cerr << "me assembler choked, " << problem << std::endl;
+        }
+        if (problems.empty()) {
+            // a program that runs ends in sys_exit, so anything Jit::run returns is a failure to get it going
+            for (const std::string& problem : Jit::run(object)) {
+                std::cerr << "me jit fell over, " << problem << std::endl;
+            }
+        }
+        return EXIT_FAILURE;
+    }
 
-    std::string asmcode = generator.generate_program();
+    PathSplit outFile = path_split(options->output);
+    std::string outPath = generate_path(outFile);
 
-    // std::cout << prog_node.value().to_string().str() << std::endl;
+    if (!options->emit_asm) {
+        X86::Encoder encoder;
+        X86::Object object = encoder.encode(code);
+        std::vector<std::string> problems = encoder.problems();
+        if (problems.empty()) {
+            problems = Elf::write_executable(object, outPath);
+        }
+        for (const std::string& problem : problems) {
+            std::cerr << "me assembler choked, " << problem << std::endl;
+        }
+        return problems.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    // std::cout << asmcode.str() << std::endl;
+    const std::string asmcode = code.render();
 
-    PathSplit outFile = path_split(argv[2]);
     PathSplit asmFile = outFile;
     PathSplit objFile = outFile;
     asmFile.file.extn = "asm";
@@ -121,7 +324,6 @@ int main(int argc, char** argv)
 
     std::string asmPath = generate_path(asmFile);
     std::string objPath = generate_path(objFile);
-    std::string outPath = generate_path(outFile);
 
     writeFile(asmPath, &asmcode);
 
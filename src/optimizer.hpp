@@ -0,0 +1,265 @@
+#pragma once
+
+#include "./arena.hpp"
+#include "./interner.hpp"
+#include "./parser.hpp"
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Rewrites the tree between analysis and code generation so constant work happens at compile time:
+//  - arithmetic on integer literals is evaluated, with the same unsigned 64-bit wraparound the generated code has
+//  - `x + 0`, `x - 0`, `x * 1`, `x / 1` become `x` and `x * 0` becomes `0`, when `x` is known to be a number. `x * 0`
+//    stays when `x` could call something or divide by zero, which has to happen even though its value goes unused
+//  - `+` on string and integer literals becomes a single string literal, numbers spelled the way _itoa prints them
+// Division by zero is left alone for the generated code to deal with. Literals too big for 64 bits are left alone too,
+// the Analyzer has already reported them.
+class Optimizer {
+public:
+    Optimizer(ArenaAllocator* allocator, Interner* interner)
+        : m_allocator(allocator)
+        , m_interner(interner)
+    {
+    }
+
+    void optimize(Node::Ast* ast)
+    {
+        m_ast = ast;
+        for (const Node::Id statement : ast->list(ast->root())) {
+            optimize_statement(statement);
+        }
+    }
+
+    // expressions rewritten, reported under --stats
+    [[nodiscard]] size_t folded() const
+    {
+        return m_folded;
+    }
+
+private:
+    void optimize_scope(const Node::Id scope)
+    {
+        for (const Node::Id statement : m_ast->list(scope)) {
+            optimize_statement(statement);
+        }
+    }
+
+    void optimize_statement(const Node::Id statement)
+    {
+        switch (m_ast->kind(statement)) {
+        case Node::Kind::Exit:
+        case Node::Kind::Print:
+        case Node::Kind::Let:
+        case Node::Kind::Assignment:
+        case Node::Kind::Return:
+            fold(m_ast->lhs(statement));
+            break;
+        case Node::Kind::Scope:
+            optimize_scope(statement);
+            break;
+        case Node::Kind::If: {
+            const Node::IfParts parts = m_ast->if_parts(statement);
+            fold(parts.condition);
+            optimize_scope(parts.scope);
+            if (parts.else_ != Node::None) {
+                optimize_statement(parts.else_);
+            }
+            break;
+        }
+        case Node::Kind::While:
+            fold(m_ast->lhs(statement));
+            optimize_scope(m_ast->rhs(statement));
+            break;
+        case Node::Kind::Function:
+            optimize_scope(m_ast->function_parts(statement).scope);
+            break;
+        default:
+            assert(false && "not a statement");
+        }
+    }
+
+    // folds bottom up, so by the time an operation is looked at its operands are as small as they get
+    void fold(const Node::Id expression)
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::Paren: {
+            // parentheses only steer the parser, the tree already has the grouping
+            const Node::Id inner = m_ast->lhs(expression);
+            fold(inner);
+            m_ast->replace(expression, inner);
+            return;
+        }
+        case Node::Kind::Call:
+            for (const Node::Id argument : m_ast->list(expression)) {
+                fold(argument);
+            }
+            return;
+        case Node::Kind::Operation:
+            fold(m_ast->lhs(expression));
+            fold(m_ast->rhs(expression));
+            if (fold_operation(expression)) {
+                m_folded++;
+            }
+            return;
+        default:
+            return;
+        }
+    }
+
+    bool fold_operation(const Node::Id expression)
+    {
+        const char op = m_ast->token(expression).value.value().front();
+        const Node::Id lhs = m_ast->lhs(expression);
+        const Node::Id rhs = m_ast->rhs(expression);
+        const auto left = int_value(lhs);
+        const auto right = int_value(rhs);
+
+        if (left.has_value() && right.has_value()) {
+            if (auto value = evaluate(op, left.value(), right.value())) {
+                replace_with_int(expression, value.value());
+                return true;
+            }
+            return false;
+        }
+
+        if (op == '+' && (is_str_literal(lhs) || is_str_literal(rhs))) {
+            const auto left_text = literal_text(lhs);
+            const auto right_text = literal_text(rhs);
+            if (!left_text.has_value() || !right_text.has_value()) {
+                return false;
+            }
+            // escape sequences stay verbatim and are expanded when the literal is emitted, so raw text concatenates
+            // the interner keeps the folded text, so equal folds share it with each other and with written literals
+            const Symbol symbol = m_interner->intern(left_text.value() + right_text.value());
+            m_ast->replace_with_leaf(
+                expression,
+                Node::Kind::StrLiteral,
+                Token {
+                    .type = TokenType::STR_LIT,
+                    .symbol = symbol,
+                    .value = m_interner->name(symbol),
+                    .position = m_ast->position(expression),
+                });
+            return true;
+        }
+
+        const bool left_num = m_ast->type(lhs) == Node::VariableType::NUM;
+        const bool right_num = m_ast->type(rhs) == Node::VariableType::NUM;
+        // x + 0, 0 + x, x - 0
+        if ((op == '+' || op == '-') && right == 0 && left_num) {
+            m_ast->replace(expression, lhs);
+            return true;
+        }
+        if (op == '+' && left == 0 && right_num) {
+            m_ast->replace(expression, rhs);
+            return true;
+        }
+        // x * 1, 1 * x, x / 1
+        if ((op == '*' || op == '/') && right == 1 && left_num) {
+            m_ast->replace(expression, lhs);
+            return true;
+        }
+        if (op == '*' && left == 1 && right_num) {
+            m_ast->replace(expression, rhs);
+            return true;
+        }
+        // x * 0, 0 * x
+        if (op == '*'
+            && ((right == 0 && left_num && !has_effects(lhs)) || (left == 0 && right_num && !has_effects(rhs)))) {
+            replace_with_int(expression, 0);
+            return true;
+        }
+        return false;
+    }
+
+    static std::optional<uint64_t> evaluate(const char op, const uint64_t left, const uint64_t right)
+    {
+        switch (op) {
+        case '+':
+            return left + right;
+        case '-':
+            return left - right;
+        case '*':
+            return left * right;
+        case '/':
+            if (right == 0) {
+                return {};
+            }
+            return left / right;
+        default:
+            return {};
+        }
+    }
+
+    void replace_with_int(const Node::Id expression, const uint64_t value)
+    {
+        m_ast->replace_with_leaf(
+            expression,
+            Node::Kind::IntLiteral,
+            Token {
+                .type = TokenType::INT_LT,
+                .value = m_allocator->store(std::to_string(value)),
+                .position = m_ast->position(expression),
+            });
+    }
+
+    // the value of an integer literal, {} for anything else or a literal that does not fit in 64 bits
+    [[nodiscard]] std::optional<uint64_t> int_value(const Node::Id expression) const
+    {
+        if (m_ast->kind(expression) != Node::Kind::IntLiteral) {
+            return {};
+        }
+        const std::string_view digits = m_ast->token(expression).value.value();
+        uint64_t value = 0;
+        const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.length(), value);
+        if (error != std::errc() || end != digits.data() + digits.length()) {
+            return {};
+        }
+        return value;
+    }
+
+    [[nodiscard]] bool is_str_literal(const Node::Id expression) const
+    {
+        return m_ast->kind(expression) == Node::Kind::StrLiteral;
+    }
+
+    // a literal as it would read inside a string literal
+    [[nodiscard]] std::optional<std::string> literal_text(const Node::Id expression) const
+    {
+        if (is_str_literal(expression)) {
+            return std::string(m_ast->token(expression).value.value());
+        }
+        if (auto value = int_value(expression)) {
+            return std::to_string(value.value());
+        }
+        return {};
+    }
+
+    // whether evaluating the expression does more than produce a value: a call, or a division by anything but a
+    // non-zero literal, which may raise SIGFPE
+    [[nodiscard]] bool has_effects(const Node::Id expression) const
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::Call:
+            return true;
+        case Node::Kind::Operation:
+            if (m_ast->token(expression).value.value().front() == '/'
+                && int_value(m_ast->rhs(expression)).value_or(0) == 0) {
+                return true;
+            }
+            return has_effects(m_ast->lhs(expression)) || has_effects(m_ast->rhs(expression));
+        case Node::Kind::Paren:
+            return has_effects(m_ast->lhs(expression));
+        default:
+            return false;
+        }
+    }
+
+    ArenaAllocator* m_allocator;
+    Interner* m_interner;
+    Node::Ast* m_ast = nullptr;
+    size_t m_folded = 0;
+};
@@ -1,542 +1,216 @@
 #pragma once
+#include <array>
+#include <cstddef>
 #include <iostream>
 #include <optional>
+#include <span>
 #include <string>
-#include <variant>
 #include <vector>
 
-#include "./arena.hpp"
+#include "./ast.hpp"
 #include "./tokenization.hpp"
 
-namespace Node {
-
-enum class VariableType { NUM, STR };
-
-VariableType tokenToDatatype(Token token)
-{
-    if (token.value.value() == "str") {
-        return VariableType::STR;
-    }
-    else if (token.value.value() == "num") {
-        return VariableType::NUM;
-    }
-    else {
-        std::cerr << "datatype " << token.value.value_or("NIL") << " not yet supported. error at "
-                  << token.position.first << ":" << token.position.second << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
-struct BaseNode {
-    std::pair<size_t, size_t> position;
-
-    [[nodiscard]] std::stringstream current_position(std::string prefix = "error at ") const
-    {
-        std::stringstream out;
-        out << prefix << position.first << ":" << position.second;
-        return out;
-    }
-};
-
-namespace Statement {
-struct Statement;
-}
-struct Scope : BaseNode {
-    std::vector<Statement::Statement*> stmts;
-};
-namespace Expression {
-struct IntLiteral : BaseNode {
-    Token int_lit;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "IntLiteral{.int_lit=" << int_lit.to_string().str() << "}";
-        return out;
-    }
-};
-struct StrLiteral : BaseNode {
-    Token str_lit;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "StrLiteral{.str_lit=\"" << str_lit.to_string().str() << "\"}";
-        return out;
-    }
-};
-struct Identifier : BaseNode {
-    Token ident;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "Identifier{.int_lit=" << ident.to_string().str() << "}";
-        return out;
-    }
-};
-struct Expression;
-struct FunctionCall : BaseNode {
-    Token ident;
-    std::vector<Expression*> arguments;
-};
-struct Operation : BaseNode {
-    Expression* left_hand;
-    Token oprator;
-    Expression* right_hand;
-};
-struct ParenthExpression : BaseNode {
-    Expression* expression;
-};
-struct Term : BaseNode {
-    std::variant<IntLiteral*, StrLiteral*, Identifier*, ParenthExpression*, FunctionCall*> term;
-};
-struct Expression : BaseNode {
-    std::variant<Term*, Operation*> expression;
-
-    [[nodiscard]] std::stringstream to_string() const
+class Parser {
+public:
+    explicit Parser(TokenStream* tokens, Node::Ast* ast, Diagnostics* diagnostics)
+        : m_tokens(tokens)
+        , m_ast(ast)
+        , m_diagnostics(diagnostics)
     {
-        std::stringstream out;
-        if (std::holds_alternative<Operation*>(expression)) {
-            auto operation = std::get<Operation*>(expression);
-            std::stringstream operationout;
-            operationout << "Operation{.left=" << operation->left_hand->to_string().str()
-                         << ", .operator=" << operation->oprator.to_string().str()
-                         << ", .right=" << operation->right_hand->to_string().str() << "}";
-            out << "Expression{.expression=" << operationout.str() << "}";
-            // out << "Expression{.expression=" << operation_to_string(std::get<Operation *>(expression)).str() << "}";
-        }
-        else if (std::holds_alternative<Term*>(expression)) {
-            Term* term = std::get<Term*>(expression);
-            std::stringstream termout;
-            // out << "Expression{.expression=" << std::get<Term *>(expression)->to_string().str() << "}";
-            if (std::holds_alternative<IntLiteral*>(term->term)) {
-                termout << "Term{.expression=" << std::get<IntLiteral*>(term->term)->to_string().str() << "}";
-            }
-            else if (std::holds_alternative<StrLiteral*>(term->term)) {
-                termout << "Term{.expression=" << std::get<StrLiteral*>(term->term)->to_string().str() << "}";
-            }
-            else if (std::holds_alternative<Identifier*>(term->term)) {
-                termout << "Term{.expression=" << std::get<Identifier*>(term->term)->to_string().str() << "}";
-            }
-            else if (std::holds_alternative<ParenthExpression*>(term->term)) {
-                // auto pexpression = std::get<ParenthExpression *>(term->term);
-                std::stringstream pexout;
-                pexout << "ParenthExpression{.expression="
-                       << std::get<ParenthExpression*>(term->term)->expression->to_string().str() << "}";
-                termout << "Term{.expression=" << pexout.str() << "}";
-            }
-            else if (std::holds_alternative<FunctionCall*>(term->term)) {
-                auto fclexpression = std::get<FunctionCall*>(term->term);
-                std::stringstream fclout;
-                fclout << "FunctionCall{.ident=" << fclexpression->ident.to_string().str() << ",.arguments=[";
-                for (const auto expr : fclexpression->arguments) {
-                    fclout << expr->to_string().str() << ",";
-                }
-                fclout << "]}";
-                termout << "Term{.expression=" << fclout.str() << "}";
-            }
-            out << "Term{.term=" << termout.str() << "}";
-        }
-        return out;
     }
-};
 
-inline std::stringstream term_to_string(const Term* term)
-{
-    std::stringstream out;
-    if (std::holds_alternative<IntLiteral*>(term->term)) {
-        out << "Term{.expression=" << std::get<IntLiteral*>(term->term)->to_string().str() << "}";
-    }
-    else if (std::holds_alternative<Identifier*>(term->term)) {
-        out << "Term{.expression=" << std::get<Identifier*>(term->term)->to_string().str() << "}";
-    }
-    else if (std::holds_alternative<ParenthExpression*>(term->term)) {
-        // auto pexpression = std::get<ParenthExpression *>(term->term);
-        std::stringstream pexout;
-        pexout << "ParenthExpression{.expression="
-               << std::get<ParenthExpression*>(term->term)->expression->to_string().str() << "}";
-        out << "Term{.expression=" << pexout.str() << "}";
-        // out << "Term{.expression=" << std::get<ParenthExpression *>(term->term)->to_string().str() << "}";
-    }
-    else if (std::holds_alternative<StrLiteral*>(term->term)) {
-        out << "Term{.expression=\"" << std::get<StrLiteral*>(term->term)->to_string().str() << "\"}";
-    }
-    return out;
-}
-
-inline std::stringstream parenth_expression_to_string(const ParenthExpression* expression)
-{
-    return expression->expression->to_string();
-}
-
-inline std::stringstream operation_to_string(const Operation* operation)
-{
-    std::stringstream out;
-    out << "Operation{.left=" << operation->left_hand->to_string().str() << ", .operator="
-        << operation->oprator.to_string().str() << ", .right=" << operation->right_hand->to_string().str() << "}";
-    return out;
-}
-};
-namespace Statement {
-struct Exit : BaseNode {
-    Expression::Expression* expression;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "Exit{.expression=" << expression->to_string().str() << "}";
-        return out;
-    }
-};
-struct Return : BaseNode {
-    Expression::Expression* expression;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "Return{.expression=" << expression->to_string().str() << "}";
-        return out;
-    }
-};
-struct Print : BaseNode {
-    Expression::Expression* expression;
-    [[nodiscard]] std::stringstream to_string() const
+    // a broken statement is reported and skipped, so the program comes back with every statement that did parse.
+    // the Program node becomes the root of the Ast.
+    Node::Id parse()
     {
-        std::stringstream out;
-        out << "Print{.expression=" << expression->to_string().str() << "}";
-        return out;
-    }
-};
-struct Let : BaseNode {
-    Token identifier;
-    Expression::Expression* expression;
-    bool mutable_;
-    std::optional<Node::VariableType> variableType;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "Let{.identifier=" << identifier.to_string().str() << ", .mutable=" << mutable_
-            << ", .expression=" << expression->to_string().str() << "}";
-        return out;
-    }
-};
-struct Assignment : BaseNode {
-    Token identifier;
-    Expression::Expression* expression;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "Assign{.identifier=" << identifier.to_string().str()
-            << ", .expression=" << expression->to_string().str() << "}";
-        return out;
-    }
-};
-struct Else;
-struct If : BaseNode {
-    Node::Expression::Expression* expression;
-    Node::Scope* scope;
-    std::optional<Else*> else_;
-};
-
-struct Argument : BaseNode {
-    Token identifier;
-    VariableType datatype;
-
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "Argument{.identifier=" << identifier.to_string().str() << ",.datatype=" << datatype << "}";
-        return out;
-    }
-};
-
-struct Function : BaseNode {
-    Token identifier;
-    std::vector<Argument*> arguments;
-    VariableType returnType;
-    Node::Scope* scope;
-};
-
-struct Else : BaseNode {
-    std::variant<If*, Scope*> else_;
-};
-
-struct While : BaseNode {
-    Node::Expression::Expression* expression;
-    Node::Scope* scope;
-};
-struct Statement : BaseNode {
-    std::variant<Exit*, Print*, Let*, Scope*, If*, Assignment*, While*, Function*, Return*> statement;
-
-    [[nodiscard]] std::stringstream to_string(If* ifnode) const
-    {
-        std::stringstream out;
-        out << "If{.expression=" << ifnode->expression->to_string().str() << ",.scope=[";
-        for (Statement* statmt : ifnode->scope->stmts) {
-            out << statmt->to_string().str() << ", ";
-        }
-        out << "],";
-        if (ifnode->else_.has_value()) {
-            if (std::holds_alternative<Scope*>(ifnode->else_.value()->else_)) {
-                auto scope = std::get<Scope*>(ifnode->else_.value()->else_);
-                out << ".else=";
-                out << to_string(scope).str();
-                out << ",";
-            }
-            else if (std::holds_alternative<If*>(ifnode->else_.value()->else_)) {
-                auto if_node = std::get<If*>(ifnode->else_.value()->else_);
-                out << ".else=" << to_string(if_node).str() << "}";
+        const size_t start = m_scratch.size();
+        while (peek() != nullptr) {
+            if (auto statement = parse_recovering()) {
+                m_scratch.push_back(statement.value());
             }
         }
-        out << "}";
-        return out;
+        const Node::Id program = add_list_node(Node::Kind::Program, Node::None, start);
+        m_ast->set_root(program);
+        return program;
     }
 
-    [[nodiscard]] std::stringstream to_string(While* whilenode) const
-    {
-        std::stringstream out;
-        out << "While{.expression=" << whilenode->expression->to_string().str() << ",.scope=[";
-        out << to_string(whilenode->scope).str() << "]}";
-        return out;
-    }
+private:
+    // thrown by error() to unwind to the innermost statement loop, which resynchronizes and carries on
+    struct ParseError { };
 
-    [[nodiscard]] std::stringstream to_string(Scope* scope) const
+    [[noreturn]] void error(std::string message)
     {
-        std::stringstream out;
-        out << "Scope{.stmts=[";
-        for (Statement* statmt : scope->stmts) {
-            out << statmt->to_string().str() << ", ";
-        }
-        out << "]}";
-        return out;
+        m_diagnostics->error(m_position, std::move(message), m_length);
+        throw ParseError {};
     }
 
-    [[nodiscard]] std::stringstream to_string(Function* fnc) const
+    std::optional<Node::Id> parse_recovering()
     {
-        std::stringstream out;
-        out << "Function{.identifier=" << fnc->identifier.to_string().str() << ",.arguments=[";
-        for (const auto arg : fnc->arguments) {
-            out << arg->to_string().str() << ",";
+        const size_t consumed = m_consumed;
+        const size_t scratch = m_scratch.size();
+        try {
+            if (auto statement = parse_statement()) {
+                return statement;
+            }
+            const Token* token = peek();
+            m_diagnostics->error(token->position, "wat di statement ya twat", token_length(*token));
         }
-        out << "],returnType=" << fnc->returnType << ",scope=Scope{.stmts=[";
-        for (const auto stmt : fnc->scope->stmts) {
-            out << stmt->to_string().str() << ",";
+        catch (const ParseError&) {
+            // lists that were being collected when the error hit are abandoned
+            m_scratch.resize(scratch);
         }
-        out << "]}}";
-        return out;
+        synchronize(consumed);
+        return {};
     }
 
-    [[nodiscard]] std::stringstream to_string() const
+    // panic mode: skips to just past the next `;` or to the `}` closing the current scope, whichever comes first.
+    // braces opened while skipping are skipped whole. always eats at least one token so the caller makes progress.
+    void synchronize(const size_t consumed)
     {
-        std::stringstream out;
-        if (std::holds_alternative<Exit*>(statement)) {
-            out << "Statement{.statement=" << std::get<Exit*>(statement)->to_string().str() << "}";
-        }
-        else if (std::holds_alternative<Return*>(statement)) {
-            out << "Statement{.statement=" << std::get<Return*>(statement)->to_string().str() << "}";
-        }
-        else if (std::holds_alternative<Print*>(statement)) {
-            out << "Statement{.statement=" << std::get<Print*>(statement)->to_string().str() << "}";
-        }
-        else if (std::holds_alternative<Let*>(statement)) {
-            out << "Statement{.statement=" << std::get<Let*>(statement)->to_string().str() << "}";
-        }
-        else if (std::holds_alternative<Assignment*>(statement)) {
-            out << "Statement{.statement=" << std::get<Assignment*>(statement)->to_string().str() << "}";
+        size_t depth = 0;
+        if (m_consumed == consumed && peek() != nullptr) {
+            depth += peek_is(TokenType::OPEN_CURLY);
+            consume();
         }
-        else if (std::holds_alternative<Scope*>(statement)) {
-            auto scope = std::get<Scope*>(statement);
-            out << "Statement{.statement=Scope{.stmts=[";
-            for (Statement* statmt : scope->stmts) {
-                out << statmt->to_string().str() << ", ";
+        while (const Token* token = peek()) {
+            switch (token->type) {
+            case TokenType::SEMICL:
+                consume();
+                if (depth == 0) {
+                    return;
+                }
+                break;
+            case TokenType::OPEN_CURLY:
+                depth++;
+                consume();
+                break;
+            case TokenType::CLOSE_CURLY:
+                if (depth == 0) {
+                    return;
+                }
+                consume();
+                // an else hangs off the block just skipped, so it goes too
+                if (--depth == 0 && !peek_is(TokenType::ELSE)) {
+                    return;
+                }
+                break;
+            case TokenType::EXIT:
+            case TokenType::PRINT:
+            case TokenType::LET:
+            case TokenType::IF:
+            case TokenType::WHILE:
+            case TokenType::FUNCTION:
+            case TokenType::RETURN:
+                if (depth == 0) {
+                    return;
+                }
+                consume();
+                break;
+            default:
+                consume();
+                break;
             }
-            out << "]}}";
-        }
-        else if (std::holds_alternative<If*>(statement)) {
-            auto ifnode = std::get<If*>(statement);
-            out << "Statement{.statement=" << to_string(ifnode).str() << "}";
-        }
-        else if (std::holds_alternative<While*>(statement)) {
-            auto whilenode = std::get<While*>(statement);
-            out << "Statement{.statement=" << to_string(whilenode).str() << "}";
-        }
-        else if (std::holds_alternative<Function*>(statement)) {
-            auto funcnode = std::get<Function*>(statement);
-            out << "Statement{.statement=" << to_string(funcnode).str() << "}";
         }
-        return out;
     }
-};
-};
-struct Program : BaseNode {
-    std::vector<Statement::Statement*> stmts;
-    [[nodiscard]] std::stringstream to_string() const
-    {
-        std::stringstream out;
-        out << "Program{.stmts=[";
-        for (Statement::Statement* statmt : stmts) {
-            out << statmt->to_string().str() << ", ";
-        }
-        out << "]}";
-        return out;
-    }
-};
-}
-
-inline size_t expression_precedence(const Node::Expression::Expression* expression)
-{
-    if (const auto term = std::get_if<Node::Expression::Term*>(&expression->expression)) {
-        if (std::holds_alternative<Node::Expression::ParenthExpression*>((*term)->term)) {
-            return 1;
-        }
-        return 0;
-    }
-    else {
-        return 0;
-    }
-}
 
-class Parser {
-public:
-    explicit Parser(const std::vector<Token>& tokens, ArenaAllocator* allocator)
-        : m_tokens(tokens)
-        , m_allocator(allocator)
+    // a node standing for `token`
+    Node::Id add_node(
+        const Node::Kind kind, const Token& token, const Node::Id lhs = Node::None, const Node::Id rhs = Node::None)
     {
+        return m_ast->add(kind, m_ast->add_token(token), lhs, rhs);
     }
 
-    Node::Program parse()
+    // a node whose children are the ids collected in m_scratch since `start`. they move to the Ast's extra.
+    Node::Id add_list_node(const Node::Kind kind, const uint32_t token, const size_t start)
     {
-        m_index = 0;
-        Node::Program program_node;
-        while (peek().has_value()) {
-            if (auto statement = parse_statement()) {
-                program_node.stmts.push_back(statement.value());
-            }
-            else {
-                std::cerr << "wat di statement ya twat" << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
-            }
-        }
-        return program_node;
+        const std::span<const Node::Id> ids = std::span(m_scratch).subspan(start);
+        const uint32_t first = m_ast->add_list(ids);
+        const auto last = static_cast<uint32_t>(first + ids.size());
+        m_scratch.resize(start);
+        return m_ast->add(kind, token, first, last);
     }
 
-private:
-    std::optional<Node::Expression::Term*> parse_term()
+    std::optional<Node::Id> parse_term()
     {
-        if (peek().has_value() && peek().value().type == TokenType::INT_LT) {
-            auto node_expression_int_lit = m_allocator->alloc<Node::Expression::IntLiteral>();
-            node_expression_int_lit->int_lit = consume().value();
-            node_expression_int_lit->position = node_expression_int_lit->position;
-            auto node_expression = m_allocator->alloc<Node::Expression::Term>();
-            node_expression->term = node_expression_int_lit;
-            node_expression->position = node_expression_int_lit->position;
-            return node_expression;
+        if (peek_is(TokenType::INT_LT)) {
+            return add_node(Node::Kind::IntLiteral, consume().value());
         }
         else if (auto fncall = parse_function_call()) {
-            auto node_expression = m_allocator->alloc<Node::Expression::Term>();
-            node_expression->term = fncall.value();
-            node_expression->position = fncall.value()->position;
-            return node_expression;
+            return fncall;
         }
-        else if (peek().has_value() && peek().value().type == TokenType::IDENT) {
-            auto node_expression_identifier = m_allocator->alloc<Node::Expression::Identifier>();
-            node_expression_identifier->ident = consume().value();
-            node_expression_identifier->position = node_expression_identifier->position;
-            auto node_expression = m_allocator->alloc<Node::Expression::Term>();
-            node_expression->term = node_expression_identifier;
-            node_expression->position = node_expression_identifier->position;
-            return node_expression;
+        else if (peek_is(TokenType::IDENT)) {
+            return add_node(Node::Kind::Identifier, consume().value());
         }
-        else if (peek().has_value() && peek().value().type == TokenType::OPEN_PAREN) {
-            consume();
+        else if (peek_is(TokenType::OPEN_PAREN)) {
+            const Token paren = consume().value();
             auto expr = parse_expression();
             if (!expr.has_value()) {
-                std::cerr << "whers ya expression ya dimwit " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("whers ya expression ya dimwit");
             }
-            if (peek().has_value() && peek().value().type == TokenType::CLOSE_PAREN) {
+            if (peek_is(TokenType::CLOSE_PAREN)) {
                 consume();
             }
             else {
-                std::cerr << "ya waitin n ya daddy to add the close parenthesis ya dong " << current_position().str()
-                          << std::endl;
-                exit(EXIT_FAILURE);
-            }
-            auto term_paren = m_allocator->alloc<Node::Expression::ParenthExpression>();
-            term_paren->expression = expr.value();
-            term_paren->position = term_paren->expression->position;
-            auto term = m_allocator->alloc<Node::Expression::Term>();
-            term->term = term_paren;
-            term->position = term_paren->position;
-            return term;
+                error("ya waitin n ya daddy to add the close parenthesis ya dong");
+            }
+            return add_node(Node::Kind::Paren, paren, expr.value());
         }
         else if (
-            peek().has_value() && peek().value().type == TokenType::DINV_COMMA && peek(1).has_value()
-            && peek(1).value().type == TokenType::STR_LIT && peek(2).has_value()
-            && peek(2).value().type == TokenType::DINV_COMMA) {
+            peek_is(TokenType::DINV_COMMA) && peek_is(TokenType::STR_LIT, 1) && peek_is(TokenType::DINV_COMMA, 2)) {
             consume();
-            auto node_expression_str_lit = m_allocator->alloc<Node::Expression::StrLiteral>();
-            node_expression_str_lit->str_lit = consume().value();
-            node_expression_str_lit->position = node_expression_str_lit->position;
-            auto node_expression = m_allocator->alloc<Node::Expression::Term>();
-            node_expression->term = node_expression_str_lit;
-            node_expression->position = node_expression_str_lit->position;
+            const Node::Id literal = add_node(Node::Kind::StrLiteral, consume().value());
             consume();
-            return node_expression;
+            return literal;
         }
         else {
             return {};
         }
     }
 
-    std::optional<Node::Expression::FunctionCall*> parse_function_call()
+    std::optional<Node::Id> parse_function_call()
     {
-        if (peek().value().type == TokenType::IDENT && peek(1).has_value()
-            && peek(1).value().type == TokenType::OPEN_PAREN) {
-            auto identifier = consume().value();
+        if (peek_is(TokenType::IDENT) && peek_is(TokenType::OPEN_PAREN, 1)) {
+            const Token identifier = consume().value();
             consume();
-            auto fn_call_node = m_allocator->alloc<Node::Expression::FunctionCall>();
-            fn_call_node->ident = identifier;
-            fn_call_node->position = identifier.position;
+            const size_t start = m_scratch.size();
             if (auto expression = parse_expression()) {
-                fn_call_node->arguments.push_back(expression.value());
-                while (peek().has_value() && peek().value().type == TokenType::COMMA) {
+                m_scratch.push_back(expression.value());
+                while (peek_is(TokenType::COMMA)) {
                     consume();
                     expression = parse_expression();
                     if (!expression.has_value()) {
-                        std::cerr << "wat dis comma for ya dimwit " << current_position().str() << std::endl;
-                        exit(EXIT_FAILURE);
+                        error("wat dis comma for ya dimwit");
                     }
-                    fn_call_node->arguments.push_back(expression.value());
+                    m_scratch.push_back(expression.value());
                 }
             }
-            if (peek().has_value() && peek().value().type == TokenType::CLOSE_PAREN) {
+            if (peek_is(TokenType::CLOSE_PAREN)) {
                 consume();
-                return fn_call_node;
+                return add_list_node(Node::Kind::Call, m_ast->add_token(identifier), start);
             }
             else {
-                std::cerr << "wat dis shit ya conk " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("wat dis shit ya conk");
             }
         }
 
         return {};
     }
 
-    std::optional<Node::Expression::Expression*> parse_expression(size_t min_prec = 0)
+    std::optional<Node::Id> parse_expression(size_t min_prec = 0)
     {
-        std::optional<Node::Expression::Term*> term_lhs = parse_term();
-        // std::cout << "Entering with min_prec=" << min_prec << std::endl;
+        std::optional<Node::Id> term_lhs = parse_term();
         if (!term_lhs.has_value()) {
             return {};
         }
 
-        auto expr_lhs = m_allocator->alloc<Node::Expression::Expression>();
-        expr_lhs->expression = term_lhs.value();
-        expr_lhs->position = term_lhs.value()->position;
+        Node::Id expr_lhs = term_lhs.value();
 
         while (true) {
-            auto cur_tok = peek();
-            if (!cur_tok.has_value()) {
+            const Token* cur_tok = peek();
+            if (cur_tok == nullptr) {
                 break;
             }
-            auto precedence = bin_precedence(cur_tok.value());
+            auto precedence = bin_precedence(*cur_tok);
             if (!precedence.has_value() || precedence < min_prec) {
                 break;
             }
@@ -545,59 +219,38 @@ private:
             auto expr_rhs = parse_expression(next_min_prec);
 
             if (!expr_rhs.has_value()) {
-                std::cerr << "wers da rigt and expression ya neandrathal " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("wers da rigt and expression ya neandrathal");
             }
 
-            auto expr = m_allocator->alloc<Node::Expression::Expression>();
-            auto operation = m_allocator->alloc<Node::Expression::Operation>();
-
-            operation->oprator = op;
-            operation->left_hand = expr_lhs;
-            operation->right_hand = expr_rhs.value();
-            operation->position = expr_lhs->position;
-
-            expr->expression = operation;
-            expr->position = operation->position;
-
-            expr_lhs = expr;
+            expr_lhs = add_node(Node::Kind::Operation, op, expr_lhs, expr_rhs.value());
         };
 
         return expr_lhs;
     }
 
-    std::optional<Node::Statement::Exit*> parse_exit()
+    std::optional<Node::Id> parse_exit()
     {
-        std::optional<Node::Statement::Exit*> op_exit_node;
-        // std::cout << peek().value().type << " : " << peek().value().value.value_or("") << std::endl;
-        if (peek().value().type == TokenType::EXIT && peek(1).has_value()
-            && peek(1).value().type == TokenType::OPEN_PAREN) {
+        std::optional<Node::Id> op_exit_node;
+        if (peek_is(TokenType::EXIT) && peek_is(TokenType::OPEN_PAREN, 1)) {
             auto exittoken = consume();
             consume();
             if (auto node_expr = parse_expression()) {
-                // exit_node = Node::Statement::Exit{.expression = node_expr.value()};
-                auto exit_node = m_allocator->alloc<Node::Statement::Exit>();
-                exit_node->expression = node_expr.value();
-                op_exit_node = exit_node;
-                exit_node->position = exittoken.value().position;
+                op_exit_node = add_node(Node::Kind::Exit, exittoken.value(), node_expr.value());
             }
             else {
-                std::cerr << "ya messed up bitches " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("ya messed up bitches");
             }
             // consume close paren
-            if (!peek().has_value() || peek().value().type != TokenType::CLOSE_PAREN) {
-                std::cerr << "ya messed up ya parenthesis twat " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+            if (!peek_is(TokenType::CLOSE_PAREN)) {
+                error("ya messed up ya parenthesis twat");
             }
             else {
                 consume();
             }
 
             // consume semicolon
-            if (!peek().has_value() || peek().value().type != TokenType::SEMICL) {
-                std::cerr << "ya messed up ya semicolon twat " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+            if (!peek_is(TokenType::SEMICL)) {
+                error("ya messed up ya semicolon twat");
             }
             else {
                 consume();
@@ -607,36 +260,29 @@ private:
         return op_exit_node;
     }
 
-    std::optional<Node::Statement::Print*> parse_print()
+    std::optional<Node::Id> parse_print()
     {
-        std::optional<Node::Statement::Print*> op_print_node;
-        if (peek().value().type == TokenType::PRINT && peek(1).has_value()
-            && peek(1).value().type == TokenType::OPEN_PAREN) {
-            auto exittoken = consume();
+        std::optional<Node::Id> op_print_node;
+        if (peek_is(TokenType::PRINT) && peek_is(TokenType::OPEN_PAREN, 1)) {
+            auto printtoken = consume();
             consume();
             if (auto node_expr = parse_expression()) {
-                auto print_node = m_allocator->alloc<Node::Statement::Print>();
-                print_node->expression = node_expr.value();
-                op_print_node = print_node;
-                print_node->position = exittoken.value().position;
+                op_print_node = add_node(Node::Kind::Print, printtoken.value(), node_expr.value());
             }
             else {
-                std::cerr << "ya messed up bitches " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("ya messed up bitches");
             }
             // consume close paren
-            if (!peek().has_value() || peek().value().type != TokenType::CLOSE_PAREN) {
-                std::cerr << "ya messed up ya parenthesis twat " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+            if (!peek_is(TokenType::CLOSE_PAREN)) {
+                error("ya messed up ya parenthesis twat");
             }
             else {
                 consume();
             }
 
             // consume semicolon
-            if (!peek().has_value() || peek().value().type != TokenType::SEMICL) {
-                std::cerr << "ya messed up ya semicolon twat " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+            if (!peek_is(TokenType::SEMICL)) {
+                error("ya messed up ya semicolon twat");
             }
             else {
                 consume();
@@ -646,78 +292,60 @@ private:
         return op_print_node;
     }
 
-    std::optional<Node::Statement::Return*> parse_return()
+    std::optional<Node::Id> parse_return()
     {
-        std::optional<Node::Statement::Return*> op_return_node;
-        if (peek().value().type == TokenType::RETURN) {
-            auto returntoken = consume().value();
-            auto return_node = m_allocator->alloc<Node::Statement::Return>();
-            return_node->position = returntoken.position;
+        if (peek_is(TokenType::RETURN)) {
+            const Token returntoken = consume().value();
+            Node::Id expression = Node::None;
             if (auto node_expr = parse_expression()) {
-                return_node->expression = node_expr.value();
+                expression = node_expr.value();
             }
             else {
-                auto default_exp = m_allocator->alloc<Node::Expression::Expression>();
-                auto default_value = m_allocator->alloc<Node::Expression::IntLiteral>();
-                auto default_term = m_allocator->alloc<Node::Expression::Term>();
-                default_value->int_lit.type = TokenType::INT_LT;
-                default_value->int_lit.value = "0";
-                default_term->term = default_value;
-                default_exp->expression = default_term;
-                return_node->expression = default_exp;
+                // a bare `return;` returns 0
+                expression = add_node(
+                    Node::Kind::IntLiteral,
+                    Token { .type = TokenType::INT_LT, .value = "0", .position = returntoken.position });
             }
 
             // consume semicolon
-            if (!peek().has_value() || peek().value().type != TokenType::SEMICL) {
-                std::cerr << "ya messed up ya semicolon twat " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+            if (!peek_is(TokenType::SEMICL)) {
+                error("ya messed up ya semicolon twat");
             }
             else {
                 consume();
             }
 
-            return return_node;
+            return add_node(Node::Kind::Return, returntoken, expression);
         }
 
         return {};
     }
 
-    std::optional<Node::Statement::Let*> parse_let()
+    std::optional<Node::Id> parse_let()
     {
-        std::optional<Node::Statement::Let*> op_let_node = {};
-        // std::cout << "let " << peek().value().type << " : " << peek().value().value.value_or("") << std::endl;
-        if (peek().value().type == TokenType::LET) {
-            auto non_mutable = peek(1).has_value() && peek(1).value().type == TokenType::IDENT && peek(2).has_value()
-                && peek(2).value().type == TokenType::EQUALS;
+        std::optional<Node::Id> op_let_node = {};
+        if (peek_is(TokenType::LET)) {
+            auto non_mutable = peek_is(TokenType::IDENT, 1) && peek_is(TokenType::EQUALS, 2);
 
-            auto mutable_ = peek(1).has_value() && peek(1).value().type == TokenType::MUTABLE && peek(2).has_value()
-                && peek(2).value().type == TokenType::IDENT && peek(3).has_value()
-                && peek(3).value().type == TokenType::EQUALS;
+            auto mutable_
+                = peek_is(TokenType::MUTABLE, 1) && peek_is(TokenType::IDENT, 2) && peek_is(TokenType::EQUALS, 3);
 
             if (mutable_ || non_mutable) {
-                auto lettoken = consume().value(); // consume let
+                consume(); // consume let
                 if (mutable_) {
                     consume(); // consume mut
                 }
                 Token ident = consume().value(); // consume token
                 consume(); // consume equals
                 if (auto node_expr = parse_expression()) {
-                    auto let_node = m_allocator->alloc<Node::Statement::Let>();
-                    let_node->identifier = ident;
-                    let_node->expression = node_expr.value();
-                    let_node->mutable_ = mutable_;
-                    let_node->position = lettoken.position;
-                    op_let_node = let_node;
-                    // Node::Statement::Let{.identifier = ident, .expression = node_expr.value()};
+                    op_let_node = add_node(Node::Kind::Let, ident, node_expr.value(), mutable_ ? 1 : 0);
                 }
                 else {
-                    std::cerr << "ya messed up bitches " << current_position().str() << std::endl;
-                    exit(EXIT_FAILURE);
+                    error("ya messed up bitches");
                 }
                 // consume semicolon
-                if (!peek().has_value() || peek().value().type != TokenType::SEMICL) {
-                    std::cerr << "ya messed up ya semicolon twat " << current_position().str() << std::endl;
-                    exit(EXIT_FAILURE);
+                if (!peek_is(TokenType::SEMICL)) {
+                    error("ya messed up ya semicolon twat");
                 }
                 else {
                     consume();
@@ -728,28 +356,21 @@ private:
         return op_let_node;
     }
 
-    std::optional<Node::Statement::Assignment*> parse_assign()
+    std::optional<Node::Id> parse_assign()
     {
-        std::optional<Node::Statement::Assignment*> op_assign_node = {};
-        if (peek().value().type == TokenType::IDENT && peek(1).has_value()
-            && peek(1).value().type == TokenType::EQUALS) {
+        std::optional<Node::Id> op_assign_node = {};
+        if (peek_is(TokenType::IDENT) && peek_is(TokenType::EQUALS, 1)) {
             Token ident = consume().value();
             consume();
             if (auto node_expr = parse_expression()) {
-                auto assign_node = m_allocator->alloc<Node::Statement::Assignment>();
-                assign_node->identifier = ident;
-                assign_node->expression = node_expr.value();
-                assign_node->position = ident.position;
-                op_assign_node = assign_node;
+                op_assign_node = add_node(Node::Kind::Assignment, ident, node_expr.value());
             }
             else {
-                std::cerr << "watchu trynna do n...." << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("watchu trynna do n....");
             }
             // consume semicolon
-            if (!peek().has_value() || peek().value().type != TokenType::SEMICL) {
-                std::cerr << "ya messed up ya semicolon twat " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+            if (!peek_is(TokenType::SEMICL)) {
+                error("ya messed up ya semicolon twat");
             }
             else {
                 consume();
@@ -759,258 +380,204 @@ private:
         return op_assign_node;
     }
 
-    std::optional<Node::Statement::Argument*> parse_argument()
+    std::optional<Node::Id> parse_argument()
     {
-        std::optional<Node::Statement::Argument*> op_argument_node = {};
-        // if (peek().has_value()) {
-        //     std::cout << "peek0 " << peek().value().to_string().str() << std::endl;
-        // }
-        // if (peek(1).has_value()) {
-        //     std::cout << "peek1 " << peek(1).value().to_string().str() << std::endl;
-        // }
-        if (peek().value().type == TokenType::IDENT && peek(1).has_value()
-            && peek(1).value().type == TokenType::DATATYPE) {
+        if (peek_is(TokenType::IDENT) && peek_is(TokenType::DATATYPE, 1)) {
             Token ident = consume().value();
             Token datatype = consume().value();
-            auto nodeArgument = m_allocator->alloc<Node::Statement::Argument>();
-            nodeArgument->identifier = ident;
-            nodeArgument->position = ident.position;
-            nodeArgument->datatype = Node::tokenToDatatype(datatype);
-            return nodeArgument;
+            const Node::VariableType type = Node::tokenToDatatype(datatype, m_diagnostics);
+            return add_node(Node::Kind::Argument, ident, Node::None, static_cast<Node::Id>(type));
         }
 
-        return op_argument_node;
+        return {};
     }
 
-    std::optional<Node::Scope*> parse_scope()
+    std::optional<Node::Id> parse_scope()
     {
-        if (peek().has_value() && peek().value().type == TokenType::OPEN_CURLY) {
-            auto curlytoken = consume();
-            auto scope = m_allocator->alloc<Node::Scope>();
-            scope->position = curlytoken.value().position;
-            while (auto statement = parse_statement()) {
-                scope->stmts.push_back(statement.value());
-            }
-            if (peek().has_value() && peek().value().type == TokenType::CLOSE_CURLY) {
+        if (peek_is(TokenType::OPEN_CURLY)) {
+            const Token curlytoken = consume().value();
+            const size_t start = m_scratch.size();
+            while (peek() != nullptr && !peek_is(TokenType::CLOSE_CURLY)) {
+                if (auto statement = parse_recovering()) {
+                    m_scratch.push_back(statement.value());
+                }
+            }
+            if (peek_is(TokenType::CLOSE_CURLY)) {
                 consume();
             }
             else {
-                std::cerr << "ya need em iq pointz to close ya scopes mf " << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("ya need em iq pointz to close ya scopes mf");
             }
-            return scope;
+            return add_list_node(Node::Kind::Scope, m_ast->add_token(curlytoken), start);
         }
         return {};
     }
 
-    std::optional<Node::Statement::Else*> parse_else()
+    // the If or Scope after an `else`
+    std::optional<Node::Id> parse_else()
     {
-        if (peek().has_value() && peek().value().type == TokenType::ELSE) {
-            auto elsetoken = consume().value();
-            auto else_statement = m_allocator->alloc<Node::Statement::Else>();
-            else_statement->position = elsetoken.position;
-            auto ifnode = parse_if();
-            if (ifnode.has_value()) {
-                else_statement->else_ = ifnode.value();
+        if (peek_is(TokenType::ELSE)) {
+            consume();
+            if (auto ifnode = parse_if()) {
+                return ifnode;
             }
-            else {
-                auto scope = parse_scope();
-                if (!scope.has_value()) {
-                    std::cerr << "if then wat mf. say it, type it. don't fuck it up " << current_position().str()
-                              << std::endl;
-                    exit(EXIT_FAILURE);
-                }
-                else_statement->else_ = scope.value();
+            auto scope = parse_scope();
+            if (!scope.has_value()) {
+                error("if then wat mf. say it, type it. don't fuck it up");
             }
-            return else_statement;
+            return scope;
         }
         return {};
     }
 
-    std::optional<Node::Statement::If*> parse_if()
+    std::optional<Node::Id> parse_if()
     {
-        if (peek().has_value() && peek().value().type == TokenType::IF) {
-            // std::cout << "checking if " << peek().value().to_string().str() << std::endl;
-            auto iftoken = consume().value();
+        if (peek_is(TokenType::IF)) {
+            const Token iftoken = consume().value();
             auto expression = parse_expression();
             if (!expression.has_value()) {
-                std::cerr << "if what mf! if what ? be clear" << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("if what mf! if what ? be clear");
             }
             auto scope = parse_scope();
             if (!scope.has_value()) {
-                std::cerr << "if then wat mf. say it, type it. don't fuck it up" << current_position().str()
-                          << std::endl;
-                exit(EXIT_FAILURE);
-            }
-            auto if_statement = m_allocator->alloc<Node::Statement::If>();
-            if_statement->position = iftoken.position;
-            if_statement->expression = expression.value();
-            if_statement->scope = scope.value();
-            auto else_statement = parse_else();
-            if_statement->else_ = else_statement;
-            return if_statement;
+                error("if then wat mf. say it, type it. don't fuck it up");
+            }
+            const std::array<Node::Id, 2> parts { scope.value(), parse_else().value_or(Node::None) };
+            return add_node(Node::Kind::If, iftoken, expression.value(), m_ast->add_list(parts));
         }
         return {};
     }
 
-    std::optional<Node::Statement::While*> parse_while()
+    std::optional<Node::Id> parse_while()
     {
-        if (peek().has_value() && peek().value().type == TokenType::WHILE) {
-            auto whiletoken = consume().value();
+        if (peek_is(TokenType::WHILE)) {
+            const Token whiletoken = consume().value();
             auto expression = parse_expression();
             if (!expression.has_value()) {
-                std::cerr << "while what mf! while what ? be clear" << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("while what mf! while what ? be clear");
             }
             auto scope = parse_scope();
             if (!scope.has_value()) {
-                std::cerr << "while then wat mf. say it, type it. don't fuck it up" << current_position().str()
-                          << std::endl;
-                exit(EXIT_FAILURE);
-            }
-            auto while_statement = m_allocator->alloc<Node::Statement::While>();
-            while_statement->position = whiletoken.position;
-            while_statement->expression = expression.value();
-            while_statement->scope = scope.value();
-            return while_statement;
+                error("while then wat mf. say it, type it. don't fuck it up");
+            }
+            return add_node(Node::Kind::While, whiletoken, expression.value(), scope.value());
         }
         return {};
     }
 
-    std::optional<Node::Statement::Function*> parse_function()
+    std::optional<Node::Id> parse_function()
     {
-        if (peek().value().type == TokenType::FUNCTION && peek(1).has_value()
-            && peek(1).value().type == TokenType::IDENT) {
+        if (peek_is(TokenType::FUNCTION) && peek_is(TokenType::IDENT, 1)) {
             Token function = consume().value();
             Token ident = consume().value();
-            if (peek().has_value() && peek().value().type == TokenType::OPEN_PAREN) {
+            if (peek_is(TokenType::OPEN_PAREN)) {
                 consume();
             }
             else {
-                std::cerr << "ya messed fn parenthesis ya bum" << std::endl;
-                exit(EXIT_FAILURE);
+                error("ya messed fn parenthesis ya bum");
             }
-            auto function_node = m_allocator->alloc<Node::Statement::Function>();
-            function_node->identifier = ident;
-            function_node->position = function.position;
+            const size_t start = m_scratch.size();
             while (auto argument = parse_argument()) {
-                function_node->arguments.push_back(argument.value());
+                m_scratch.push_back(argument.value());
             }
-            if (peek().has_value() && peek().value().type == TokenType::CLOSE_PAREN) {
+            if (peek_is(TokenType::CLOSE_PAREN)) {
                 consume();
             }
             else {
-                std::cerr << "ya messed fn close parenthesis ya bum" << std::endl;
-                exit(EXIT_FAILURE);
+                error("ya messed fn close parenthesis ya bum");
             }
-            if (peek().has_value() && peek().value().type == TokenType::DATATYPE) {
-                function_node->returnType = Node::tokenToDatatype(consume().value());
+            Node::VariableType return_type = Node::VariableType::NUM;
+            if (peek_is(TokenType::DATATYPE)) {
+                return_type = Node::tokenToDatatype(consume().value(), m_diagnostics);
             }
             else {
-                std::cerr << "ya messed fn return type ya bum" << std::endl;
-                exit(EXIT_FAILURE);
+                error("ya messed fn return type ya bum");
             }
             auto scope = parse_scope();
             if (!scope.has_value()) {
-                std::cerr << "ya missed the function body ya dick" << current_position().str() << std::endl;
-                exit(EXIT_FAILURE);
+                error("ya missed the function body ya dick");
             }
-            function_node->scope = scope.value();
-            return function_node;
+            // the arguments are already collected, the rest of the function goes in front of them
+            const std::array<Node::Id, 3> header {
+                add_node(Node::Kind::Identifier, ident),
+                static_cast<Node::Id>(return_type),
+                scope.value(),
+            };
+            m_scratch.insert(m_scratch.begin() + static_cast<std::ptrdiff_t>(start), header.begin(), header.end());
+            return add_list_node(Node::Kind::Function, m_ast->add_token(function), start);
         }
 
         return {};
     }
 
-    std::optional<Node::Statement::Statement*> parse_statement()
+    // every statement is decided by its leading token, so this never backtracks
+    std::optional<Node::Id> parse_statement()
     {
-        if (auto exit_node = parse_exit()) {
-            auto node_statement = m_allocator->alloc<Node::Statement::Statement>();
-            node_statement->statement = exit_node.value();
-            node_statement->position = exit_node.value()->position;
-            return node_statement;
-        }
-        if (auto return_node = parse_return()) {
-            auto node_statement = m_allocator->alloc<Node::Statement::Statement>();
-            node_statement->statement = return_node.value();
-            node_statement->position = return_node.value()->position;
-            return node_statement;
-        }
-        if (auto print_node = parse_print()) {
-            auto node_statement = m_allocator->alloc<Node::Statement::Statement>();
-            node_statement->statement = print_node.value();
-            node_statement->position = print_node.value()->position;
-            return node_statement;
-        }
-        if (auto let_node = parse_let()) {
-            auto node_statement = m_allocator->alloc<Node::Statement::Statement>();
-            node_statement->statement = let_node.value();
-            node_statement->position = let_node.value()->position;
-            return node_statement;
-        }
-        if (auto assign_node = parse_assign()) {
-            auto node_statement = m_allocator->alloc<Node::Statement::Statement>();
-            node_statement->statement = assign_node.value();
-            node_statement->position = assign_node.value()->position;
-            return node_statement;
-        }
-        if (auto scope_node = parse_scope()) {
-            auto scope_statement = m_allocator->alloc<Node::Statement::Statement>();
-            scope_statement->statement = scope_node.value();
-            scope_statement->position = scope_node.value()->position;
-            return scope_statement;
-        }
-        if (auto if_node = parse_if()) {
-            auto if_statement = m_allocator->alloc<Node::Statement::Statement>();
-            if_statement->statement = if_node.value();
-            if_statement->position = if_node.value()->position;
-            return if_statement;
-        }
-        if (auto while_node = parse_while()) {
-            auto while_statement = m_allocator->alloc<Node::Statement::Statement>();
-            while_statement->statement = while_node.value();
-            while_statement->position = while_node.value()->position;
-            return while_statement;
+        const Token* token = peek();
+        if (token == nullptr) {
+            return {};
         }
-        if (auto fn_node = parse_function()) {
-            auto fn_statement = m_allocator->alloc<Node::Statement::Statement>();
-            fn_statement->statement = fn_node.value();
-            fn_statement->position = fn_node.value()->position;
-            return fn_statement;
+        switch (token->type) {
+        case TokenType::EXIT:
+            return parse_exit();
+        case TokenType::RETURN:
+            return parse_return();
+        case TokenType::PRINT:
+            return parse_print();
+        case TokenType::LET:
+            return parse_let();
+        case TokenType::IDENT:
+            return parse_assign();
+        case TokenType::OPEN_CURLY:
+            return parse_scope();
+        case TokenType::IF:
+            return parse_if();
+        case TokenType::WHILE:
+            return parse_while();
+        case TokenType::FUNCTION:
+            return parse_function();
+        default:
+            return {};
         }
-        return {};
-        // std::cerr << "ya messed up wat ts shit" << std::endl;
-        // exit(EXIT_FAILURE);
     }
 
-    [[nodiscard]] std::optional<Token> peek(const size_t ahead = 0) const
+    // nullptr past the end of the input. the pointer is only good until the next consume().
+    [[nodiscard]] const Token* peek(const size_t ahead = 0)
     {
-        if (m_index + ahead >= m_tokens.size()) {
-            return {};
-        }
-        return m_tokens.at(m_index + ahead);
+        return m_tokens->peek(ahead);
+    }
+
+    [[nodiscard]] bool peek_is(const TokenType type, const size_t ahead = 0)
+    {
+        const Token* token = peek(ahead);
+        return token != nullptr && token->type == type;
     }
 
     std::optional<Token> consume()
     {
-        if (m_index >= m_tokens.size()) {
-            return {};
+        auto token = m_tokens->next();
+        if (token.has_value()) {
+            m_position = token.value().position;
+            m_length = token_length(token.value());
+            m_consumed++;
         }
-        auto token = m_tokens.at(m_index++);
-        m_position = token.position;
         return token;
     }
-    const std::vector<Token> m_tokens;
-    size_t m_index = 0;
-    ArenaAllocator* m_allocator;
 
-    std::pair<size_t, size_t> m_position = { 0, 0 };
-
-    std::stringstream current_position(std::string prefix = "error at ")
+    // keywords and punctuation carry no spelling, so their spans are a single character
+    static size_t token_length(const Token& token)
     {
-        std::stringstream out;
-        out << prefix << m_position.first << ":" << m_position.second;
-        return out;
+        return std::max<size_t>(token.value.value_or("").length(), 1);
     }
+
+    TokenStream* m_tokens;
+    Node::Ast* m_ast;
+    Diagnostics* m_diagnostics;
+    // children of the lists being parsed, innermost last, until their node is made
+    std::vector<Node::Id> m_scratch {};
+
+    // span of the last consumed token, where errors are reported
+    size_t m_position = 0;
+    size_t m_length = 1;
+    size_t m_consumed = 0;
 };
\ No newline at end of file
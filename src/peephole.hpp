@@ -0,0 +1,405 @@
+#pragma once
+
+#include "./x86.hpp"
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Local rewrites over the instruction stream, run at -O1. Every rule looks at a handful of neighbouring instructions
+// inside straight line code; labels, jumps, calls, syscalls and raw text end the window, comments are looked through.
+//  - `push X` ... `pop Y` becomes `mov Y, X`, or nothing when X is Y, as long as nothing in between touches the stack,
+//    changes X or uses Y
+//  - `mov r, r` is dropped
+//  - `mov r, imm` feeding the next instruction is folded into it when r is overwritten before it is read again
+//  - `mov [m], r` followed by `mov r, [m]` loses the reload
+//  - `test r, r` right after arithmetic that already set the zero flag for r is dropped, and a test of a register just
+//    loaded with a constant settles the jump that follows at compile time
+// Rules are applied until none fires, each one only ever removes or simplifies instructions.
+class Peephole {
+public:
+    // the number of instructions removed
+    size_t run(X86::Code& code)
+    {
+        const size_t before = code.instruction_count();
+        m_lines = &code.lines();
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            m_dead.assign(m_lines->size(), false);
+            for (size_t i = 0; i < m_lines->size(); i++) {
+                if (m_dead[i] || instruction(i) == nullptr) {
+                    continue;
+                }
+                changed |= remove_self_move(i) || fold_push_pop(i) || fold_immediate(i) || fold_reload(i)
+                    || fold_test(i);
+            }
+            compact();
+        }
+        return before - code.instruction_count();
+    }
+
+private:
+    static constexpr size_t Window = 16;
+    static constexpr size_t None = SIZE_MAX;
+
+    struct Effects {
+        uint32_t reads = 0;
+        uint32_t writes = 0;
+        bool reads_memory = false;
+        bool writes_memory = false;
+        // anything we do not model, or that leaves straight line code
+        bool barrier = false;
+    };
+
+    static Effects effects(const X86::Instruction& instruction)
+    {
+        Effects effects;
+        const std::vector<X86::Operand>& operands = instruction.operands;
+        const std::string& opcode = instruction.opcode;
+        for (const X86::Operand& operand : operands) {
+            if (operand.is_memory()) {
+                effects.reads |= operand.registers();
+            }
+        }
+        const auto source = [&](const X86::Operand& operand) {
+            effects.reads |= operand.registers();
+            effects.reads_memory |= operand.is_memory();
+        };
+        const auto destination = [&](const X86::Operand& operand, const bool read) {
+            if (operand.is_register()) {
+                effects.writes |= operand.registers();
+                if (read || !operand.replaces_register()) {
+                    effects.reads |= operand.registers();
+                }
+            }
+            else if (operand.is_memory()) {
+                effects.writes_memory = true;
+                effects.reads_memory |= read;
+            }
+        };
+        const uint32_t rax = X86::register_bit("rax");
+        const uint32_t rdx = X86::register_bit("rdx");
+        const uint32_t rsp = X86::register_bit("rsp");
+
+        if ((opcode == "mov" || opcode == "movzx" || opcode == "movsx") && operands.size() == 2) {
+            destination(operands[0], false);
+            source(operands[1]);
+        }
+        else if (opcode == "lea" && operands.size() == 2) {
+            destination(operands[0], false);
+        }
+        else if (opcode == "xor" && operands.size() == 2 && operands[0].is_register() && operands[0] == operands[1]) {
+            // the zeroing idiom does not depend on the old value
+            destination(operands[0], false);
+        }
+        else if (
+            (opcode == "add" || opcode == "sub" || opcode == "and" || opcode == "or" || opcode == "xor"
+             || opcode == "imul")
+            && operands.size() == 2) {
+            destination(operands[0], true);
+            source(operands[1]);
+        }
+        else if (opcode == "imul" && operands.size() == 3) {
+            destination(operands[0], false);
+            source(operands[1]);
+        }
+        else if ((opcode == "cmp" || opcode == "test") && operands.size() == 2) {
+            source(operands[0]);
+            source(operands[1]);
+        }
+        else if ((opcode == "inc" || opcode == "dec" || opcode == "neg" || opcode == "not") && operands.size() == 1) {
+            destination(operands[0], true);
+        }
+        else if (opcode == "push" && operands.size() == 1) {
+            source(operands[0]);
+            effects.reads |= rsp;
+            effects.writes |= rsp;
+            effects.writes_memory = true;
+        }
+        else if (opcode == "pop" && operands.size() == 1) {
+            destination(operands[0], false);
+            effects.reads |= rsp;
+            effects.writes |= rsp;
+            effects.reads_memory = true;
+        }
+        else if ((opcode == "mul" || opcode == "div" || opcode == "imul") && operands.size() == 1) {
+            source(operands[0]);
+            effects.reads |= rax | rdx;
+            effects.writes |= rax | rdx;
+        }
+        else {
+            effects.barrier = true;
+        }
+        return effects;
+    }
+
+    X86::Instruction* instruction(const size_t index) const
+    {
+        if (index >= m_lines->size() || (*m_lines)[index].kind != X86::Line::Kind::Instruction) {
+            return nullptr;
+        }
+        return &(*m_lines)[index].instruction;
+    }
+
+    // the next line that is still there and not a comment
+    size_t next(size_t index) const
+    {
+        for (index++; index < m_lines->size(); index++) {
+            if (!m_dead[index] && (*m_lines)[index].kind != X86::Line::Kind::Comment) {
+                return index;
+            }
+        }
+        return None;
+    }
+
+    size_t previous(size_t index) const
+    {
+        while (index-- > 0) {
+            if (!m_dead[index] && (*m_lines)[index].kind != X86::Line::Kind::Comment) {
+                return index;
+            }
+        }
+        return None;
+    }
+
+    void remove(const size_t index)
+    {
+        m_dead[index] = true;
+    }
+
+    void compact()
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < m_lines->size(); i++) {
+            if (m_dead[i]) {
+                continue;
+            }
+            if (kept != i) {
+                (*m_lines)[kept] = std::move((*m_lines)[i]);
+            }
+            kept++;
+        }
+        m_lines->resize(kept);
+    }
+
+    static bool is(const X86::Instruction* instruction, const std::string_view opcode, const size_t operands)
+    {
+        return instruction != nullptr && instruction->opcode == opcode && instruction->operands.size() == operands;
+    }
+
+    static bool is_zero_jump(const X86::Instruction* instruction)
+    {
+        return is(instruction, "jz", 1) || is(instruction, "je", 1);
+    }
+
+    static bool is_nonzero_jump(const X86::Instruction* instruction)
+    {
+        return is(instruction, "jnz", 1) || is(instruction, "jne", 1);
+    }
+
+    // an immediate as the 64-bit value it stands for, {} for anything else
+    static std::optional<int64_t> immediate_value(const X86::Operand& operand)
+    {
+        if (!operand.is_immediate()) {
+            return {};
+        }
+        const std::string& text = operand.text;
+        const char* end = text.data() + text.length();
+        if (text.front() == '-') {
+            int64_t value = 0;
+            const auto [last, error] = std::from_chars(text.data(), end, value);
+            return error == std::errc() && last == end ? std::optional(value) : std::nullopt;
+        }
+        uint64_t value = 0;
+        const auto [last, error] = std::from_chars(text.data(), end, value);
+        return error == std::errc() && last == end ? std::optional(int64_t(value)) : std::nullopt;
+    }
+
+    static bool is_imm32(const int64_t value)
+    {
+        return value >= INT32_MIN && value <= INT32_MAX;
+    }
+
+    // whether the register is written before anything after index reads it
+    bool dead_after(const size_t index, const uint32_t reg) const
+    {
+        for (size_t i = next(index); i != None; i = next(i)) {
+            const X86::Instruction* following = instruction(i);
+            if (following == nullptr) {
+                return false;
+            }
+            const Effects effect = effects(*following);
+            if (effect.barrier || (effect.reads & reg) != 0) {
+                return false;
+            }
+            if ((effect.writes & reg) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool remove_self_move(const size_t index)
+    {
+        const X86::Instruction* move = instruction(index);
+        if (is(move, "mov", 2) && move->operands[0].is_register64() && move->operands[0] == move->operands[1]) {
+            remove(index);
+            return true;
+        }
+        return false;
+    }
+
+    bool fold_push_pop(const size_t index)
+    {
+        X86::Instruction* push = instruction(index);
+        if (!is(push, "push", 1)) {
+            return false;
+        }
+        const X86::Operand& value = push->operands[0];
+        const uint32_t rsp = X86::register_bit("rsp");
+        // registers the instructions between the two read or write
+        uint32_t touched = 0;
+        size_t steps = 0;
+        for (size_t i = next(index); i != None && steps < Window; i = next(i), steps++) {
+            const X86::Instruction* between = instruction(i);
+            if (between == nullptr) {
+                return false;
+            }
+            if (is(between, "pop", 1)) {
+                const X86::Operand& target = between->operands[0];
+                if (!target.is_register64() || (touched & target.registers()) != 0) {
+                    return false;
+                }
+                if (!(value == target)) {
+                    *push = { .opcode = "mov", .operands = { target, value }, .comment = push->comment };
+                }
+                else {
+                    remove(index);
+                }
+                remove(i);
+                return true;
+            }
+            const Effects effect = effects(*between);
+            if (effect.barrier || ((effect.reads | effect.writes) & rsp) != 0
+                || (effect.writes & value.registers()) != 0 || (value.is_memory() && effect.writes_memory)) {
+                return false;
+            }
+            touched |= effect.reads | effect.writes;
+        }
+        return false;
+    }
+
+    bool fold_immediate(const size_t index)
+    {
+        const X86::Instruction* load = instruction(index);
+        if (!is(load, "mov", 2) || !load->operands[0].is_register64()) {
+            return false;
+        }
+        const auto value = immediate_value(load->operands[1]);
+        if (!value.has_value()) {
+            return false;
+        }
+        const size_t user_index = next(index);
+        X86::Instruction* user = user_index == None ? nullptr : instruction(user_index);
+        if (user == nullptr || user->operands.empty()) {
+            return false;
+        }
+        const std::string& opcode = user->opcode;
+        const bool foldable = opcode == "mov" || opcode == "add" || opcode == "sub" || opcode == "and"
+            || opcode == "or" || opcode == "xor" || opcode == "cmp" || opcode == "push"
+            || (opcode == "imul" && user->operands.size() == 2);
+        const uint32_t reg = load->operands[0].registers();
+        X86::Operand& last = user->operands.back();
+        if (!foldable || !(last == load->operands[0])) {
+            return false;
+        }
+        for (size_t i = 0; i + 1 < user->operands.size(); i++) {
+            if ((user->operands[i].registers() & reg) != 0) {
+                return false;
+            }
+        }
+        // only a move into a register takes a full 64-bit immediate, everything else sign extends 32 bits
+        const bool wide = opcode == "mov" && user->operands[0].is_register();
+        if (!wide && !is_imm32(value.value())) {
+            return false;
+        }
+        if (!dead_after(user_index, reg)) {
+            return false;
+        }
+        last = load->operands[1];
+        if (opcode == "imul") {
+            const X86::Operand product = user->operands[0];
+            user->operands.insert(user->operands.begin() + 1, product);
+        }
+        else if (opcode == "mov" && user->operands[0].is_memory() && !user->operands[0].text.starts_with("QWORD")) {
+            // nothing else says how wide the store is
+            user->operands[0].text = "QWORD " + user->operands[0].text;
+        }
+        remove(index);
+        return true;
+    }
+
+    bool fold_reload(const size_t index)
+    {
+        const X86::Instruction* store = instruction(index);
+        if (!is(store, "mov", 2) || !store->operands[0].is_memory() || !store->operands[1].is_register64()) {
+            return false;
+        }
+        const size_t load_index = next(index);
+        const X86::Instruction* load = load_index == None ? nullptr : instruction(load_index);
+        if (is(load, "mov", 2) && load->operands[0] == store->operands[1] && load->operands[1] == store->operands[0]
+            && (store->operands[0].registers() & store->operands[1].registers()) == 0) {
+            remove(load_index);
+            return true;
+        }
+        return false;
+    }
+
+    bool fold_test(const size_t index)
+    {
+        const X86::Instruction* test = instruction(index);
+        const bool tests_register = is(test, "test", 2) && test->operands[0].is_register64()
+            && test->operands[0] == test->operands[1];
+        const bool compares_zero = is(test, "cmp", 2) && test->operands[0].is_register64()
+            && immediate_value(test->operands[1]) == 0;
+        if (!tests_register && !compares_zero) {
+            return false;
+        }
+        const size_t jump_index = next(index);
+        X86::Instruction* jump = jump_index == None ? nullptr : instruction(jump_index);
+        if (!is_zero_jump(jump) && !is_nonzero_jump(jump)) {
+            return false;
+        }
+        const size_t before_index = previous(index);
+        const X86::Instruction* before = before_index == None ? nullptr : instruction(before_index);
+        if (before == nullptr || before->operands.empty() || !(before->operands[0] == test->operands[0])) {
+            return false;
+        }
+        const std::string& opcode = before->opcode;
+        if (opcode == "add" || opcode == "sub" || opcode == "and" || opcode == "or" || opcode == "xor"
+            || opcode == "inc" || opcode == "dec" || opcode == "neg") {
+            // these leave the zero flag set exactly when the result is zero
+            remove(index);
+            return true;
+        }
+        if (is(before, "mov", 2)) {
+            if (const auto value = immediate_value(before->operands[1])) {
+                if ((value.value() == 0) == is_zero_jump(jump)) {
+                    jump->opcode = "jmp";
+                }
+                else {
+                    remove(jump_index);
+                }
+                remove(index);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<X86::Line>* m_lines = nullptr;
+    std::vector<bool> m_dead {};
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "./parser.hpp"
+#include "./symbols.hpp"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Linear scan register allocation for num variables, used by -O1.
+//
+// Statements are numbered in program order and every let gets a live interval from its own statement to the last one
+// that reads or writes it. A variable declared outside a while loop and touched inside it stays live until the loop
+// ends, since the next iteration reads it again. Intervals are then walked in start order, handing out a free register
+// when there is one; a variable that finds none keeps its stack slot, as everything does at -O0.
+//
+// Only registers that neither the generated code nor the runtime helpers clobber are handed out. rax/rbx/rdx carry
+// expression values, rcx/rsi/rdi/r11 go to _itoa and the syscalls, r12-r15 to _runtime_concat.
+class RegisterAllocator {
+public:
+    static constexpr std::array<std::string_view, 4> Registers { "rbp", "r8", "r9", "r10" };
+
+    // Let node -> the register its variable lives in
+    using Allocation = std::unordered_map<Node::Id, std::string_view>;
+
+    Allocation allocate(const Node::Ast& ast)
+    {
+        m_ast = &ast;
+        for (const Node::Id statement : ast.list(ast.root())) {
+            visit_statement(statement);
+        }
+        return scan();
+    }
+
+private:
+    struct Interval {
+        Node::Id let;
+        size_t start;
+        size_t end;
+        Node::VariableType type;
+    };
+    struct Loop {
+        size_t start;
+        // intervals declared before the loop and used inside it
+        std::vector<size_t> used;
+    };
+
+    Allocation scan() const
+    {
+        Allocation allocation;
+        std::vector<const Interval*> active;
+        std::vector<std::string_view> free(Registers.rbegin(), Registers.rend());
+        for (const Interval& interval : m_intervals) {
+            if (interval.type != Node::VariableType::NUM) {
+                continue;
+            }
+            std::erase_if(active, [&](const Interval* other) {
+                if (other->end < interval.start) {
+                    free.push_back(allocation.at(other->let));
+                    return true;
+                }
+                return false;
+            });
+            if (free.empty()) {
+                continue;
+            }
+            allocation[interval.let] = free.back();
+            free.pop_back();
+            active.push_back(&interval);
+        }
+        return allocation;
+    }
+
+    void visit_scope(const Node::Id scope)
+    {
+        m_variables.begin_scope();
+        for (const Node::Id statement : m_ast->list(scope)) {
+            visit_statement(statement);
+        }
+        m_variables.end_scope();
+    }
+
+    void visit_statement(const Node::Id statement)
+    {
+        visit_statement(statement, m_index++);
+    }
+
+    void visit_statement(const Node::Id statement, const size_t index)
+    {
+        switch (m_ast->kind(statement)) {
+        case Node::Kind::Exit:
+        case Node::Kind::Print:
+        case Node::Kind::Return:
+            visit_expression(m_ast->lhs(statement), index);
+            break;
+        case Node::Kind::Let: {
+            visit_expression(m_ast->lhs(statement), index);
+            m_variables.declare(m_ast->token(statement).symbol, m_intervals.size());
+            m_intervals.push_back(
+                {
+                    .let = statement,
+                    .start = index,
+                    .end = index,
+                    .type = m_ast->type(m_ast->lhs(statement)),
+                });
+            break;
+        }
+        case Node::Kind::Assignment:
+            visit_expression(m_ast->lhs(statement), index);
+            use(m_ast->token(statement).symbol, index);
+            break;
+        case Node::Kind::Scope:
+            visit_scope(statement);
+            break;
+        case Node::Kind::If: {
+            const Node::IfParts parts = m_ast->if_parts(statement);
+            visit_expression(parts.condition, index);
+            visit_scope(parts.scope);
+            if (parts.else_ != Node::None) {
+                // an else-if shares the number of the if it hangs off
+                if (m_ast->kind(parts.else_) == Node::Kind::Scope) {
+                    visit_scope(parts.else_);
+                }
+                else {
+                    visit_statement(parts.else_, index);
+                }
+            }
+            break;
+        }
+        case Node::Kind::While: {
+            m_loops.push_back({ .start = index });
+            visit_expression(m_ast->lhs(statement), index);
+            visit_scope(m_ast->rhs(statement));
+            const size_t end = m_index++;
+            Loop loop = std::move(m_loops.back());
+            m_loops.pop_back();
+            for (const size_t interval : loop.used) {
+                m_intervals.at(interval).end = end;
+                used_in_loop(interval);
+            }
+            break;
+        }
+        case Node::Kind::Function:
+            // functions have no code generation yet, so nothing in them is worth a register
+            break;
+        default:
+            assert(false && "not a statement");
+        }
+    }
+
+    void visit_expression(const Node::Id expression, const size_t index)
+    {
+        switch (m_ast->kind(expression)) {
+        case Node::Kind::Identifier:
+            use(m_ast->token(expression).symbol, index);
+            break;
+        case Node::Kind::Operation:
+            visit_expression(m_ast->lhs(expression), index);
+            visit_expression(m_ast->rhs(expression), index);
+            break;
+        case Node::Kind::Paren:
+            visit_expression(m_ast->lhs(expression), index);
+            break;
+        case Node::Kind::Call:
+            for (const Node::Id argument : m_ast->list(expression)) {
+                visit_expression(argument, index);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void use(const Symbol symbol, const size_t index)
+    {
+        const size_t* variable = m_variables.find(symbol);
+        if (variable == nullptr) {
+            return;
+        }
+        Interval& interval = m_intervals.at(*variable);
+        interval.end = std::max(interval.end, index);
+        used_in_loop(*variable);
+    }
+
+    // remembers a use inside the innermost loop that the variable was declared outside of
+    void used_in_loop(const size_t interval)
+    {
+        if (!m_loops.empty() && m_intervals.at(interval).start < m_loops.back().start) {
+            m_loops.back().used.push_back(interval);
+        }
+    }
+
+    const Node::Ast* m_ast = nullptr;
+    size_t m_index = 0;
+    std::vector<Interval> m_intervals {};
+    // the interval of each variable in scope
+    SymbolTable<size_t> m_variables {};
+    std::vector<Loop> m_loops {};
+};
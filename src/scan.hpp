@@ -0,0 +1,202 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Byte-run scanners for the tokenizer. Each one returns the index of the first byte at or after `index` that ends the
+// run (or src.length()). The vector paths handle 32 (AVX2) or 16 (SSE2) bytes per step and fall back to the scalar
+// loop for the tail, so the results are identical on every target.
+namespace Scan {
+
+constexpr bool is_space(const char c)
+{
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+constexpr bool is_digit(const char c)
+{
+    return static_cast<unsigned char>(c - '0') <= 9;
+}
+
+constexpr bool is_alpha(const char c)
+{
+    return static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a';
+}
+
+constexpr bool is_alnum(const char c)
+{
+    return is_alpha(c) || is_digit(c);
+}
+
+#if defined(__AVX2__)
+using Block = __m256i;
+constexpr size_t BlockSize = 32;
+
+inline Block load(const char* ptr)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+}
+inline Block splat(const char c)
+{
+    return _mm256_set1_epi8(c);
+}
+inline Block sub(const Block a, const Block b)
+{
+    return _mm256_sub_epi8(a, b);
+}
+inline Block eq(const Block a, const Block b)
+{
+    return _mm256_cmpeq_epi8(a, b);
+}
+inline Block either(const Block a, const Block b)
+{
+    return _mm256_or_si256(a, b);
+}
+// a <= b, comparing bytes as unsigned
+inline Block at_most(const Block a, const Block b)
+{
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(a, b), a);
+}
+inline uint32_t mask(const Block a)
+{
+    return static_cast<uint32_t>(_mm256_movemask_epi8(a));
+}
+#elif defined(__SSE2__)
+using Block = __m128i;
+constexpr size_t BlockSize = 16;
+
+inline Block load(const char* ptr)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+}
+inline Block splat(const char c)
+{
+    return _mm_set1_epi8(c);
+}
+inline Block sub(const Block a, const Block b)
+{
+    return _mm_sub_epi8(a, b);
+}
+inline Block eq(const Block a, const Block b)
+{
+    return _mm_cmpeq_epi8(a, b);
+}
+inline Block either(const Block a, const Block b)
+{
+    return _mm_or_si128(a, b);
+}
+inline Block at_most(const Block a, const Block b)
+{
+    return _mm_cmpeq_epi8(_mm_min_epu8(a, b), a);
+}
+inline uint32_t mask(const Block a)
+{
+    return static_cast<uint32_t>(_mm_movemask_epi8(a));
+}
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#define HELIUM_SCAN_SIMD 1
+constexpr uint32_t FullMask = BlockSize == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+
+// runs `in_class` over whole blocks while every byte belongs to the class
+template <typename Classify>
+size_t skip_blocks(const std::string_view src, size_t index, Classify in_class)
+{
+    while (index + BlockSize <= src.length()) {
+        const uint32_t outside = ~mask(in_class(load(src.data() + index))) & FullMask;
+        if (outside != 0) {
+            return index + std::countr_zero(outside);
+        }
+        index += BlockSize;
+    }
+    return index;
+}
+#endif
+
+inline size_t skip_whitespace(const std::string_view src, size_t index)
+{
+#ifdef HELIUM_SCAN_SIMD
+    index = skip_blocks(src, index, [](const Block bytes) {
+        return either(eq(bytes, splat(' ')), at_most(sub(bytes, splat('\t')), splat('\r' - '\t')));
+    });
+#endif
+    while (index < src.length() && is_space(src[index])) {
+        index++;
+    }
+    return index;
+}
+
+inline size_t skip_digits(const std::string_view src, size_t index)
+{
+#ifdef HELIUM_SCAN_SIMD
+    index = skip_blocks(src, index, [](const Block bytes) { return at_most(sub(bytes, splat('0')), splat(9)); });
+#endif
+    while (index < src.length() && is_digit(src[index])) {
+        index++;
+    }
+    return index;
+}
+
+inline size_t skip_alnum(const std::string_view src, size_t index)
+{
+#ifdef HELIUM_SCAN_SIMD
+    index = skip_blocks(src, index, [](const Block bytes) {
+        const Block letter = at_most(sub(either(bytes, splat(0x20)), splat('a')), splat('z' - 'a'));
+        const Block digit = at_most(sub(bytes, splat('0')), splat(9));
+        return either(letter, digit);
+    });
+#endif
+    while (index < src.length() && is_alnum(src[index])) {
+        index++;
+    }
+    return index;
+}
+
+// index of the next `c`, or src.length()
+inline size_t find(const std::string_view src, size_t index, const char c)
+{
+#ifdef HELIUM_SCAN_SIMD
+    while (index + BlockSize <= src.length()) {
+        const uint32_t hits = mask(eq(load(src.data() + index), splat(c)));
+        if (hits != 0) {
+            return index + std::countr_zero(hits);
+        }
+        index += BlockSize;
+    }
+#endif
+    while (index < src.length() && src[index] != c) {
+        index++;
+    }
+    return index;
+}
+
+// index of the next `first` immediately followed by `second`, or src.length()
+inline size_t find_pair(const std::string_view src, size_t index, const char first, const char second)
+{
+#ifdef HELIUM_SCAN_SIMD
+    while (index + BlockSize + 1 <= src.length()) {
+        const Block firsts = eq(load(src.data() + index), splat(first));
+        const Block seconds = eq(load(src.data() + index + 1), splat(second));
+        const uint32_t hits = mask(firsts) & mask(seconds);
+        if (hits != 0) {
+            return index + std::countr_zero(hits);
+        }
+        index += BlockSize;
+    }
+#endif
+    while (index + 1 < src.length() && (src[index] != first || src[index + 1] != second)) {
+        index++;
+    }
+    return index + 1 < src.length() ? index : src.length();
+}
+
+}
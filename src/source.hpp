@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The program text for one compile. Regular files are mapped read-only and tokenized in place; stdin ("-"), pipes and
+// anything else mmap refuses are read into an owned buffer instead. Tokens view into this, so it has to outlive them.
+class SourceFile final {
+public:
+    explicit SourceFile(const std::string& path)
+    {
+        const int fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "cant find ya file " << path << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        struct stat info { };
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+                m_mapped = static_cast<const char*>(mapped);
+                m_length = info.st_size;
+            }
+        }
+        if (m_mapped == nullptr) {
+            read_all(fd);
+        }
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+    }
+
+    SourceFile(const SourceFile& other) = delete;
+
+    SourceFile operator=(const SourceFile& other) = delete;
+
+    ~SourceFile()
+    {
+        if (m_mapped != nullptr) {
+            munmap(const_cast<char*>(m_mapped), m_length);
+        }
+    }
+
+    [[nodiscard]] std::string_view view() const
+    {
+        if (m_mapped != nullptr) {
+            return { m_mapped, m_length };
+        }
+        return m_buffer;
+    }
+
+private:
+    void read_all(const int fd)
+    {
+        char chunk[64 * 1024];
+        ssize_t count;
+        while ((count = read(fd, chunk, sizeof(chunk))) > 0) {
+            m_buffer.append(chunk, count);
+        }
+        if (count < 0) {
+            std::cerr << "cant read ya file" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    const char* m_mapped = nullptr;
+    size_t m_length = 0;
+    std::string m_buffer;
+};
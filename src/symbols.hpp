@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "./interner.hpp"
+
+// Scoped name -> T table for the passes that resolve variables.
+//
+// Declarations live on one stack in declaration order, and each remembers the entry it shadows. Symbols are dense, so
+// the innermost entry of every symbol is found by plain indexing rather than hashing; leaving a scope pops its entries
+// and puts back what they shadowed, which costs one step per declaration and nothing per name in the program.
+template <typename T>
+class SymbolTable {
+public:
+    struct Entry {
+        Symbol symbol;
+        // the entry of the same symbol this one hides, or None
+        uint32_t shadowed;
+        T value;
+    };
+
+    void begin_scope()
+    {
+        m_scopes.push_back(m_entries.size());
+    }
+
+    void end_scope()
+    {
+        while (m_entries.size() > m_scopes.back()) {
+            const Entry& entry = m_entries.back();
+            m_innermost[entry.symbol] = entry.shadowed;
+            m_entries.pop_back();
+        }
+        m_scopes.pop_back();
+    }
+
+    // the returned reference lasts until the next declare
+    T& declare(const Symbol symbol, T value)
+    {
+        if (symbol >= m_innermost.size()) {
+            m_innermost.resize(symbol + 1, None);
+        }
+        m_entries.push_back({ .symbol = symbol, .shadowed = m_innermost[symbol], .value = std::move(value) });
+        m_innermost[symbol] = static_cast<uint32_t>(m_entries.size() - 1);
+        return m_entries.back().value;
+    }
+
+    // the innermost declaration of the symbol in any enclosing scope
+    T* find(const Symbol symbol)
+    {
+        if (symbol >= m_innermost.size() || m_innermost[symbol] == None) {
+            return nullptr;
+        }
+        return &m_entries[m_innermost[symbol]].value;
+    }
+
+    const T* find(const Symbol symbol) const
+    {
+        return const_cast<SymbolTable*>(this)->find(symbol);
+    }
+
+    // whether the symbol is already declared in the innermost scope itself, which shadowing does not cover
+    [[nodiscard]] bool declared_in_scope(const Symbol symbol) const
+    {
+        const size_t start = m_scopes.empty() ? 0 : m_scopes.back();
+        return symbol < m_innermost.size() && m_innermost[symbol] != None && m_innermost[symbol] >= start;
+    }
+
+    // the declarations of the innermost scope, oldest first
+    std::span<const Entry> scope() const
+    {
+        const size_t start = m_scopes.empty() ? 0 : m_scopes.back();
+        return std::span(m_entries).subspan(start);
+    }
+
+    std::span<const Entry> entries() const
+    {
+        return m_entries;
+    }
+
+private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    std::vector<Entry> m_entries {};
+    std::vector<uint32_t> m_innermost {};
+    std::vector<size_t> m_scopes {};
+};
@@ -1,13 +1,20 @@
 #pragma once
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "./diagnostics.hpp"
+#include "./interner.hpp"
+#include "./scan.hpp"
+
 enum class TokenType {
     EXIT,
     LET,
@@ -33,11 +40,57 @@ enum class TokenType {
     RETURN,
 };
 
-const std::vector<std::pair<std::string, std::string>> Comments = {
-    { "//", "\n" },
-    { "/*", "*/" },
+struct Keyword {
+    std::string_view spelling;
+    TokenType type;
+};
+
+// adding a keyword is a one line change here
+constexpr std::array Keywords {
+    Keyword { "exit", TokenType::EXIT },
+    Keyword { "num", TokenType::DATATYPE },
+    Keyword { "str", TokenType::DATATYPE },
+    Keyword { "fn", TokenType::FUNCTION },
+    Keyword { "return", TokenType::RETURN },
+    Keyword { "while", TokenType::WHILE },
+    Keyword { "let", TokenType::LET },
+    Keyword { "mut", TokenType::MUTABLE },
+    Keyword { "print", TokenType::PRINT },
+    Keyword { "if", TokenType::IF },
+    Keyword { "else", TokenType::ELSE },
 };
 
+constexpr size_t KeywordSlots = 32;
+
+// perfect hash over Keywords, the static_assert below catches a new keyword that collides
+constexpr size_t keyword_slot(const std::string_view word)
+{
+    return (static_cast<unsigned char>(word.front()) + static_cast<unsigned char>(word.back()) + word.length())
+        % KeywordSlots;
+}
+
+// slot -> 1 + index into Keywords, 0 marks an empty slot
+constexpr std::array<uint8_t, KeywordSlots> KeywordTable = [] {
+    std::array<uint8_t, KeywordSlots> table {};
+    for (size_t i = 0; i < Keywords.size(); i++) {
+        table.at(keyword_slot(Keywords.at(i).spelling)) = static_cast<uint8_t>(i + 1);
+    }
+    return table;
+}();
+
+static_assert(
+    std::ranges::count_if(KeywordTable, [](const uint8_t entry) { return entry != 0; }) == Keywords.size(),
+    "keyword_slot() collides for the current Keywords, tweak the hash");
+
+constexpr std::optional<TokenType> keyword_type(const std::string_view word)
+{
+    const uint8_t entry = KeywordTable[keyword_slot(word)];
+    if (entry == 0 || Keywords[entry - 1].spelling != word) {
+        return {};
+    }
+    return Keywords[entry - 1].type;
+}
+
 const std::vector Operators {
     '+',
     '-',
@@ -46,11 +99,11 @@ const std::vector Operators {
     // '%',
 };
 
-const std::unordered_map<std::string, size_t> OperatorPrecedence {
-    { "+", 0 },
-    { "-", 0 },
-    { "/", 1 },
-    { "*", 1 },
+const std::unordered_map<char, size_t> OperatorPrecedence {
+    { '+', 0 },
+    { '-', 0 },
+    { '/', 1 },
+    { '*', 1 },
 };
 
 template <typename T>
@@ -59,10 +112,14 @@ std::ostream& operator<<(std::enable_if_t<std::is_enum_v<T>, std::ostream>& stre
     return stream << static_cast<std::underlying_type_t<T>>(e);
 }
 
+// `value` views into the source buffer, so the source has to outlive every Token.
+// Keywords and punctuation carry no value at all. `position` is the byte offset of the token, see SourceMap.
 struct Token {
     TokenType type;
-    std::optional<std::string> value;
-    std::pair<size_t, size_t> position;
+    // the interned spelling of an identifier or string literal, NoSymbol for anything else
+    Symbol symbol = NoSymbol;
+    std::optional<std::string_view> value;
+    size_t position;
     [[nodiscard]] std::stringstream to_string() const
     {
         std::stringstream out;
@@ -74,8 +131,8 @@ struct Token {
 inline std::optional<size_t> bin_precedence(const Token& token)
 {
     if (token.type == TokenType::OPERATOR) {
-        if (OperatorPrecedence.contains(token.value.value())) {
-            return OperatorPrecedence.at(token.value.value());
+        if (OperatorPrecedence.contains(token.value.value().front())) {
+            return OperatorPrecedence.at(token.value.value().front());
         }
         assert(false); // not supported;
     }
@@ -84,267 +141,199 @@ inline std::optional<size_t> bin_precedence(const Token& token)
 
 class Tokenizer {
 public:
-    explicit Tokenizer(std::string src)
-        : m_src(std::move(src))
+    Tokenizer(const std::string_view src, Diagnostics* diagnostics, Interner* interner)
+        : m_src(src)
+        , m_diagnostics(diagnostics)
+        , m_interner(interner)
     {
     }
 
-    std::vector<Token> tokenize()
+    // lexes one token on demand, {} once the source is exhausted
+    std::optional<Token> next()
     {
-        m_index = 0;
-        std::string buffer;
-        std::vector<Token> tokens;
-        while (peek().has_value()) {
-            // std::cout << "At " << m_index << " Char " << peek().value() << std::endl;
-            if (std::isalpha(peek().value())) {
-                buffer.push_back(consume().value());
-                while (peek().has_value() && std::isalnum(peek().value())) {
-                    buffer.push_back(consume().value());
-                }
-                if (buffer == "exit") {
-                    tokens.push_back({ .type = TokenType::EXIT, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got Exit " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "num") {
-                    tokens.push_back(
-                        { .type = TokenType::DATATYPE, .value = buffer, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got num datatype " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "str") {
-                    tokens.push_back(
-                        { .type = TokenType::DATATYPE, .value = buffer, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got str datatype " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "fn") {
-                    tokens.push_back({ .type = TokenType::FUNCTION, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got FUNCTION " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "return") {
-                    tokens.push_back({ .type = TokenType::RETURN, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got return " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "while") {
-                    tokens.push_back({ .type = TokenType::WHILE, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got while " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "let") {
-                    tokens.push_back({ .type = TokenType::LET, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got let " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "mut") {
-                    tokens.push_back({ .type = TokenType::MUTABLE, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got mut " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "print") {
-                    tokens.push_back({ .type = TokenType::PRINT, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got print " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "if") {
-                    tokens.push_back({ .type = TokenType::IF, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got if " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                if (buffer == "else") {
-                    tokens.push_back({ .type = TokenType::ELSE, .position = { m_lineno, m_colno } });
-                    // std::cout << "Got else " << buffer << std::endl;
-                    buffer.clear();
-                    continue;
-                }
-                tokens.push_back({ .type = TokenType::IDENT, .value = buffer, .position = { m_lineno, m_colno } });
-                buffer.clear();
+        if (m_queued_count > 0) {
+            return m_queued.at(m_queued.size() - m_queued_count--);
+        }
+        while (m_index < m_src.length()) {
+            const char c = m_src[m_index];
+            const size_t start = m_index;
+            if (Scan::is_space(c)) {
+                m_index = Scan::skip_whitespace(m_src, m_index + 1);
                 continue;
-                // std::cerr << "ya messed up bitches" << std::endl;
-                // exit(EXIT_FAILURE);
             }
-            {
-                auto foundComments = false;
-                for (const auto& comment : Comments) {
-                    bool hasStart = true;
-                    for (size_t i = 0; i < comment.first.length(); i++) {
-                        if (peek(i).has_value() && peek(i).value() != comment.first.at(i)) {
-                            hasStart = false;
-                        }
-                    }
-                    if (hasStart) {
-                        foundComments = true;
-                        // comment started
-
-                        // consume comment starting item
-                        // ReSharper disable once CppDFAUnreadVariable
-                        for (auto _ : comment.first) {
-                            consume();
-                        }
-                        while (true) {
-                            bool isComment = false;
-                            for (size_t i = 0; i < comment.second.length(); i++) {
-                                if (peek(i).has_value() && peek(i).value() != comment.second.at(i)) {
-                                    isComment = true;
-                                }
-                            }
-                            if (isComment) {
-                                consume();
-                                if (!peek().has_value()) {
-                                    // std::cerr << "close ya comment ya bitch " << current_position().str() <<
-                                    // std::endl; exit(EXIT_FAILURE);
-                                    break;
-                                }
-                            }
-                            else {
-                                // ReSharper disable once CppDFAUnreadVariable
-                                for (auto _ : comment.second) {
-                                    consume();
-                                }
-                                break;
-                            }
-                        }
+            if (Scan::is_alpha(c)) {
+                m_index = Scan::skip_alnum(m_src, m_index + 1);
+                const std::string_view buffer = view(start);
+                if (const auto keyword = keyword_type(buffer)) {
+                    if (keyword.value() == TokenType::DATATYPE) {
+                        // the parser tells num and str apart by spelling
+                        return Token { .type = TokenType::DATATYPE, .value = buffer, .position = start };
                     }
+                    return Token { .type = keyword.value(), .position = start };
                 }
-                if (foundComments) {
-                    continue;
-                }
+                return Token {
+                    .type = TokenType::IDENT,
+                    .symbol = m_interner->intern(buffer),
+                    .value = buffer,
+                    .position = start,
+                };
             }
-            if (std::isdigit(peek().value())) {
-                buffer.push_back(consume().value());
-                while (peek().has_value() && std::isdigit(peek().value())) {
-                    buffer.push_back(consume().value());
-                }
-                tokens.push_back({ .type = TokenType::INT_LT, .value = buffer, .position = { m_lineno, m_colno } });
-                // std::cout << "Got INT_LT " << buffer << std::endl;
-                buffer.clear();
+            if (c == '/' && m_index + 1 < m_src.length() && m_src[m_index + 1] == '/') {
+                // the newline itself is left for the whitespace skip
+                m_index = Scan::find(m_src, m_index + 2, '\n');
                 continue;
             }
-            if (peek().value() == ',') {
-                consume();
-                tokens.push_back({ .type = TokenType::COMMA, .position = { m_lineno, m_colno } });
+            if (c == '/' && m_index + 1 < m_src.length() && m_src[m_index + 1] == '*') {
+                const size_t end = Scan::find_pair(m_src, m_index + 2, '*', '/');
+                if (end == m_src.length()) {
+                    m_diagnostics->error(start, "close ya comment ya bitch", 2);
+                    m_index = end;
+                    continue;
+                }
+                m_index = end + 2;
                 continue;
             }
-            if (peek().value() == '(') {
-                consume();
-                tokens.push_back({ .type = TokenType::OPEN_PAREN, .position = { m_lineno, m_colno } });
-                continue;
+            if (Scan::is_digit(c)) {
+                m_index = Scan::skip_digits(m_src, m_index + 1);
+                return Token { .type = TokenType::INT_LT, .value = view(start), .position = start };
             }
-            if (peek().value() == ')') {
-                consume();
-                tokens.push_back({ .type = TokenType::CLOSE_PAREN, .position = { m_lineno, m_colno } });
-                continue;
+            if (c == ',') {
+                m_index++;
+                return Token { .type = TokenType::COMMA, .position = start };
             }
-            if (peek().value() == '{') {
-                consume();
-                tokens.push_back({ .type = TokenType::OPEN_CURLY, .position = { m_lineno, m_colno } });
-                continue;
+            if (c == '(') {
+                m_index++;
+                return Token { .type = TokenType::OPEN_PAREN, .position = start };
             }
-            if (peek().value() == '}') {
-                consume();
-                tokens.push_back({ .type = TokenType::CLOSE_CURLY, .position = { m_lineno, m_colno } });
-                continue;
+            if (c == ')') {
+                m_index++;
+                return Token { .type = TokenType::CLOSE_PAREN, .position = start };
             }
-            if (peek().value() == '"') {
-                // std::cout << "inside string" << std::endl;
-                auto prevChar = consume();
-                tokens.push_back({ .type = TokenType::DINV_COMMA, .position = { m_lineno, m_colno } });
-                while (peek().has_value()) {
-                    auto currChar = consume().value();
-                    if (currChar == '"' && prevChar == '\\') {
-                        buffer.push_back(currChar);
-                    }
-                    else if (currChar == '"') {
-                        break;
-                    }
-                    else {
-                        buffer.push_back(currChar);
-                        prevChar = currChar;
-                    }
-                }
-                tokens.push_back({ .type = TokenType::STR_LIT, .value = buffer, .position = { m_lineno, m_colno } });
-                // std::cout << "consumed string " << buffer << " peek=" << peek().value_or('-') << std::endl;
-                buffer.clear();
-                tokens.push_back({ .type = TokenType::DINV_COMMA, .position = { m_lineno, m_colno } });
-                continue;
+            if (c == '{') {
+                m_index++;
+                return Token { .type = TokenType::OPEN_CURLY, .position = start };
             }
-            if (peek().value() == '=') {
-                consume();
-                // std::cout << "Got SEMICL " << buffer << std::endl;
-                tokens.push_back({ .type = TokenType::EQUALS, .position = { m_lineno, m_colno } });
-                continue;
+            if (c == '}') {
+                m_index++;
+                return Token { .type = TokenType::CLOSE_CURLY, .position = start };
             }
-            if (std::ranges::find(Operators, peek().value()) != Operators.end()) {
-                tokens.push_back(
-                    {
-                        .type = TokenType::OPERATOR,
-                        .value = std::string { consume().value() },
-                        .position = { m_lineno, m_colno },
-                    });
-                continue;
+            if (c == '"') {
+                // the literal keeps its escape sequences verbatim, so it is just a slice of the source.
+                // a quote after an odd number of backslashes is escaped and does not close it, `\\"` does.
+                const size_t literal = start + 1;
+                size_t end = Scan::find(m_src, literal, '"');
+                while (end < m_src.length() && escaped(literal, end)) {
+                    end = Scan::find(m_src, end + 1, '"');
+                }
+                if (end == m_src.length()) {
+                    m_diagnostics->error(start, "close ya string ya bitch", 1);
+                    m_index = end;
+                    continue;
+                }
+                m_index = end + 1;
+                // the literal and its closing quote are handed out by the next two calls
+                const std::string_view text = m_src.substr(literal, end - literal);
+                m_queued = {
+                    Token {
+                        .type = TokenType::STR_LIT,
+                        .symbol = m_interner->intern(text),
+                        .value = text,
+                        .position = literal,
+                    },
+                    Token { .type = TokenType::DINV_COMMA, .position = end },
+                };
+                m_queued_count = m_queued.size();
+                return Token { .type = TokenType::DINV_COMMA, .position = start };
             }
-            if (peek().value() == ';') {
-                consume();
-                // std::cout << "Got SEMICL " << buffer << std::endl;
-                tokens.push_back({ .type = TokenType::SEMICL, .position = { m_lineno, m_colno } });
-                continue;
+            if (c == '=') {
+                m_index++;
+                return Token { .type = TokenType::EQUALS, .position = start };
             }
-            if (std::isspace(peek().value())) {
-                consume();
-                continue;
+            if (std::ranges::find(Operators, c) != Operators.end()) {
+                m_index++;
+                return Token {
+                    .type = TokenType::OPERATOR,
+                    .value = view(start),
+                    .position = start,
+                };
+            }
+            if (c == ';') {
+                m_index++;
+                return Token { .type = TokenType::SEMICL, .position = start };
             }
-            std::cerr << "ye or me messed up ya savagez" << current_position().str() << std::endl;
-            exit(EXIT_FAILURE);
+            // reported and skipped, so the parser still sees the rest of the file
+            m_diagnostics->error(start, "ye or me messed up ya savagez");
+            m_index++;
         }
-        return tokens;
+        return {};
     }
 
 private:
-    [[nodiscard]] std::optional<char> peek(const size_t ahead = 0) const
+    // the bytes consumed since `start`, as a view into m_src
+    [[nodiscard]] std::string_view view(const size_t start) const
     {
-        if (m_index + ahead >= m_src.length()) {
-            return {};
+        return m_src.substr(start, m_index - start);
+    }
+
+    // whether the quote at `quote` is escaped, counting the backslashes right before it back to `literal`
+    [[nodiscard]] bool escaped(const size_t literal, const size_t quote) const
+    {
+        size_t backslashes = 0;
+        while (quote - backslashes > literal && m_src[quote - backslashes - 1] == '\\') {
+            backslashes++;
         }
-        return m_src.at(m_index + ahead);
+        return backslashes % 2 == 1;
     }
 
-    std::stringstream current_position(std::string prefix = "error at ")
+    const std::string_view m_src;
+    Diagnostics* m_diagnostics;
+    Interner* m_interner;
+    size_t m_index = 0;
+    // a string literal lexes to three tokens, the last two wait here
+    std::array<Token, 2> m_queued {};
+    size_t m_queued_count = 0;
+};
+
+// Pulls tokens from a Tokenizer as the parser asks for them and keeps only a fixed ring of lookahead, so token memory
+// stays constant whatever the size of the input.
+class TokenStream {
+public:
+    static constexpr size_t Lookahead = 4;
+
+    explicit TokenStream(Tokenizer* tokenizer)
+        : m_tokenizer(tokenizer)
     {
-        std::stringstream out;
-        out << prefix << m_lineno << ":" << m_colno;
-        return out;
     }
 
-    std::optional<char> consume()
+    // nullptr once the input runs out. the pointer stays valid until the token is consumed.
+    [[nodiscard]] const Token* peek(const size_t ahead = 0)
     {
-        if (m_index >= m_src.length()) {
-            return {};
-        }
-        auto c = m_src.at(m_index++);
-        if (c == '\n') {
-            m_lineno += 1;
-            m_colno = 1;
+        assert(ahead < Lookahead && "peeking past the lookahead window");
+        while (m_count <= ahead) {
+            auto token = m_tokenizer->next();
+            if (!token.has_value()) {
+                return nullptr;
+            }
+            m_ring[(m_head + m_count) % Lookahead] = token.value();
+            m_count++;
         }
-        else {
-            m_colno += 1;
+        return &m_ring[(m_head + ahead) % Lookahead];
+    }
+
+    std::optional<Token> next()
+    {
+        const Token* token = peek();
+        if (token == nullptr) {
+            return {};
         }
-        return c;
+        m_head = (m_head + 1) % Lookahead;
+        m_count--;
+        return *token;
     }
 
-    const std::string m_src;
-    size_t m_index = 0;
-    size_t m_lineno = 1;
-    size_t m_colno = 1;
+private:
+    Tokenizer* m_tokenizer;
+    std::array<Token, Lookahead> m_ring {};
+    size_t m_head = 0;
+    size_t m_count = 0;
 };
\ No newline at end of file
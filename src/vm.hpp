@@ -0,0 +1,281 @@
+#pragma once
+
+#include "./bytecode.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Runs a Bytecode::Program in the compiler's own process, for `helium vm`.
+//
+// Dispatch is threaded: before running, every instruction gets the address of its handler (the labels-as-values GNU
+// extension, which GCC and Clang both have), and each handler ends by jumping straight to the next one's. There is no
+// central switch, so every handler has its own indirect jump for the branch predictor to learn. The runtime is the
+// native one redone in C++: strings come from a bump heap that print and conditions roll back, and output goes
+// through the same 64 KB buffer, written when it fills up and on exit.
+namespace VM {
+
+// a num is in `num`, a str is `ptr` and its length in `num`
+struct Value {
+    const char* ptr;
+    uint64_t num;
+};
+
+// bump allocation over chunks of at least a megabyte that are never moved, so strings stay put. rolling back to a
+// mark keeps the chunks past it around for reuse.
+class Heap {
+public:
+    char* allocate(const size_t size)
+    {
+        if (static_cast<size_t>(m_end - m_top) < size) {
+            next_chunk(size);
+        }
+        char* start = m_top;
+        m_top += size;
+        return start;
+    }
+
+    [[nodiscard]] Value mark() const
+    {
+        return { .ptr = m_top, .num = m_used };
+    }
+
+    void release(const Value& mark)
+    {
+        m_used = mark.num;
+        m_top = const_cast<char*>(mark.ptr);
+        m_end = m_used == 0 ? nullptr : m_chunks[m_used - 1].bytes.get() + m_chunks[m_used - 1].size;
+    }
+
+private:
+    static constexpr size_t ChunkSize = 1 << 20;
+
+    struct Chunk {
+        std::unique_ptr<char[]> bytes;
+        size_t size;
+    };
+
+    void next_chunk(const size_t size)
+    {
+        if (m_used == m_chunks.size() || m_chunks[m_used].size < size) {
+            const size_t chunk = std::max(size, ChunkSize);
+            Chunk fresh { .bytes = std::make_unique_for_overwrite<char[]>(chunk), .size = chunk };
+            // chunks past the ones in use hold nothing live
+            if (m_used == m_chunks.size()) {
+                m_chunks.push_back(std::move(fresh));
+            }
+            else {
+                m_chunks[m_used] = std::move(fresh);
+            }
+        }
+        m_top = m_chunks[m_used].bytes.get();
+        m_end = m_top + m_chunks[m_used].size;
+        m_used++;
+    }
+
+    std::vector<Chunk> m_chunks {};
+    size_t m_used = 0;
+    char* m_top = nullptr;
+    char* m_end = nullptr;
+};
+
+// the runtime's _print, _flush and _write
+class Output {
+public:
+    explicit Output(const bool unbuffered)
+        : m_unbuffered(unbuffered)
+    {
+    }
+
+    void print(const char* text, const size_t length)
+    {
+        if (m_unbuffered) {
+            write(text, length);
+            return;
+        }
+        if (m_length + length > Size) {
+            flush();
+            if (length > Size) {
+                write(text, length);
+                return;
+            }
+        }
+        std::memcpy(m_buffer.data() + m_length, text, length);
+        m_length += length;
+    }
+
+    void flush()
+    {
+        write(m_buffer.data(), m_length);
+        m_length = 0;
+    }
+
+private:
+    static constexpr size_t Size = 65536;
+
+    static void write(const char* text, size_t length)
+    {
+        while (length > 0) {
+            const ssize_t written = ::write(STDOUT_FILENO, text, length);
+            // nowhere to report a failed write to, drop the rest
+            if (written <= 0) {
+                return;
+            }
+            text += written;
+            length -= static_cast<size_t>(written);
+        }
+    }
+
+    bool m_unbuffered;
+    std::array<char, Size> m_buffer {};
+    size_t m_length = 0;
+};
+
+// runs the program to its exit and returns the status it exits with
+inline int run(const Bytecode::Program& program, const bool unbuffered)
+{
+    using Bytecode::Op;
+
+    struct Threaded {
+        const void* handler;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+    };
+
+    // in the order of Bytecode::Op
+    static const void* const handlers[] = {
+        &&num,
+        &&str,
+        &&move,
+        &&add,
+        &&sub,
+        &&mul,
+        &&div,
+        &&concat_str_str,
+        &&concat_str_num,
+        &&concat_num_str,
+        &&print_num,
+        &&print_str,
+        &&mark,
+        &&release,
+        &&jump,
+        &&jump_if_zero,
+        &&jump_if_empty,
+        &&exit,
+    };
+    static_assert(std::size(handlers) == static_cast<size_t>(Op::Exit) + 1);
+
+    std::vector<Threaded> code;
+    code.reserve(program.code.size());
+    for (const Bytecode::Instruction& instruction : program.code) {
+        code.push_back(
+            {
+                .handler = handlers[static_cast<size_t>(instruction.op)],
+                .a = instruction.a,
+                .b = instruction.b,
+                .c = instruction.c,
+            });
+    }
+    std::vector<Value> values(program.registers);
+    Value* const r = values.data();
+    const uint64_t* const numbers = program.numbers.data();
+    const std::string* const strings = program.strings.data();
+    Heap heap;
+    Output output(unbuffered);
+    // 20 digits is the most a 64-bit number takes
+    std::array<char, 20> digits {};
+    const auto spell = [&digits](const uint64_t value) {
+        return static_cast<size_t>(std::to_chars(digits.begin(), digits.end(), value).ptr - digits.begin());
+    };
+
+    const Threaded* ip = code.data();
+    goto* ip->handler;
+
+num:
+    r[ip->a].num = numbers[ip->b];
+    goto* (++ip)->handler;
+str:
+    r[ip->a] = { .ptr = strings[ip->b].data(), .num = strings[ip->b].size() };
+    goto* (++ip)->handler;
+move:
+    r[ip->a] = r[ip->b];
+    goto* (++ip)->handler;
+add:
+    r[ip->a].num = r[ip->b].num + r[ip->c].num;
+    goto* (++ip)->handler;
+sub:
+    r[ip->a].num = r[ip->b].num - r[ip->c].num;
+    goto* (++ip)->handler;
+mul:
+    r[ip->a].num = r[ip->b].num * r[ip->c].num;
+    goto* (++ip)->handler;
+div:
+    if (r[ip->c].num == 0) {
+        // what the native div does, buffered output is lost the same way
+        std::raise(SIGFPE);
+        r[ip->a].num = 0;
+        goto* (++ip)->handler;
+    }
+    r[ip->a].num = r[ip->b].num / r[ip->c].num;
+    goto* (++ip)->handler;
+concat_str_str: {
+    const Value left = r[ip->b];
+    const Value right = r[ip->c];
+    char* joined = heap.allocate(left.num + right.num);
+    std::memcpy(joined, left.ptr, left.num);
+    std::memcpy(joined + left.num, right.ptr, right.num);
+    r[ip->a] = { .ptr = joined, .num = left.num + right.num };
+    goto* (++ip)->handler;
+}
+concat_str_num: {
+    const Value left = r[ip->b];
+    const size_t length = spell(r[ip->c].num);
+    char* joined = heap.allocate(left.num + length);
+    std::memcpy(joined, left.ptr, left.num);
+    std::memcpy(joined + left.num, digits.data(), length);
+    r[ip->a] = { .ptr = joined, .num = left.num + length };
+    goto* (++ip)->handler;
+}
+concat_num_str: {
+    const size_t length = spell(r[ip->b].num);
+    const Value right = r[ip->c];
+    char* joined = heap.allocate(length + right.num);
+    std::memcpy(joined, digits.data(), length);
+    std::memcpy(joined + length, right.ptr, right.num);
+    r[ip->a] = { .ptr = joined, .num = length + right.num };
+    goto* (++ip)->handler;
+}
+print_num:
+    output.print(digits.data(), spell(r[ip->a].num));
+    goto* (++ip)->handler;
+print_str:
+    output.print(r[ip->a].ptr, r[ip->a].num);
+    goto* (++ip)->handler;
+mark:
+    r[ip->a] = heap.mark();
+    goto* (++ip)->handler;
+release:
+    heap.release(r[ip->a]);
+    goto* (++ip)->handler;
+jump:
+    ip = code.data() + ip->a;
+    goto* ip->handler;
+jump_if_zero:
+    ip = r[ip->a].num == 0 ? code.data() + ip->b : ip + 1;
+    goto* ip->handler;
+jump_if_empty:
+    ip = r[ip->a].num == 0 ? code.data() + ip->b : ip + 1;
+    goto* ip->handler;
+exit:
+    output.flush();
+    return static_cast<int>(r[ip->a].num & 0xFF);
+}
+
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The instruction stream the generators emit into. It renders to the same NASM text they used to write by hand, but
+// stays a list of opcodes and classified operands until then, so passes like the peephole optimizer can look at it.
+namespace X86 {
+
+constexpr std::array<std::string_view, 16> Registers64 { "rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp",
+                                                         "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15" };
+
+struct RegisterName {
+    // into Registers64
+    size_t index;
+    size_t bits;
+};
+
+// any spelling of a general purpose register (eax, dl, r8d, ...)
+inline std::optional<RegisterName> lookup_register(const std::string_view name)
+{
+    static constexpr std::array<std::array<std::string_view, 4>, 16> spellings { {
+        { "rax", "eax", "ax", "al" },
+        { "rbx", "ebx", "bx", "bl" },
+        { "rcx", "ecx", "cx", "cl" },
+        { "rdx", "edx", "dx", "dl" },
+        { "rsi", "esi", "si", "sil" },
+        { "rdi", "edi", "di", "dil" },
+        { "rbp", "ebp", "bp", "bpl" },
+        { "rsp", "esp", "sp", "spl" },
+        { "r8", "r8d", "r8w", "r8b" },
+        { "r9", "r9d", "r9w", "r9b" },
+        { "r10", "r10d", "r10w", "r10b" },
+        { "r11", "r11d", "r11w", "r11b" },
+        { "r12", "r12d", "r12w", "r12b" },
+        { "r13", "r13d", "r13w", "r13b" },
+        { "r14", "r14d", "r14w", "r14b" },
+        { "r15", "r15d", "r15w", "r15b" },
+    } };
+    static constexpr std::array<size_t, 4> widths { 64, 32, 16, 8 };
+    for (size_t i = 0; i < spellings.size(); i++) {
+        for (size_t width = 0; width < widths.size(); width++) {
+            if (spellings[i][width] == name) {
+                return RegisterName { .index = i, .bits = widths[width] };
+            }
+        }
+    }
+    return {};
+}
+
+inline std::optional<size_t> register_index(const std::string_view name)
+{
+    const auto reg = lookup_register(name);
+    return reg.has_value() ? std::optional(reg->index) : std::nullopt;
+}
+
+inline uint32_t register_bit(const std::string_view name)
+{
+    const auto index = register_index(name);
+    return index.has_value() ? uint32_t(1) << index.value() : 0;
+}
+
+struct Operand {
+    enum class Kind {
+        Register,
+        Immediate,
+        Memory,
+        Symbol,
+    };
+
+    Kind kind;
+    std::string text;
+
+    static Operand parse(const std::string_view text)
+    {
+        Kind kind = Kind::Symbol;
+        if (text.find('[') != std::string_view::npos) {
+            kind = Kind::Memory;
+        }
+        else if (register_index(text).has_value()) {
+            kind = Kind::Register;
+        }
+        else if (!text.empty() && (std::isdigit(text.front()) || (text.front() == '-' && text.length() > 1))) {
+            kind = Kind::Immediate;
+        }
+        return { .kind = kind, .text = std::string(text) };
+    }
+
+    [[nodiscard]] bool is_register() const
+    {
+        return kind == Kind::Register;
+    }
+    [[nodiscard]] bool is_immediate() const
+    {
+        return kind == Kind::Immediate;
+    }
+    [[nodiscard]] bool is_memory() const
+    {
+        return kind == Kind::Memory;
+    }
+
+    [[nodiscard]] bool is_register64() const
+    {
+        return is_register() && lookup_register(text)->bits == 64;
+    }
+
+    // writing a 64 or 32-bit register replaces all of it, a narrower one keeps the rest
+    [[nodiscard]] bool replaces_register() const
+    {
+        return is_register() && lookup_register(text)->bits >= 32;
+    }
+
+    // the registers this operand reads just by being there: itself, or the ones in its address
+    [[nodiscard]] uint32_t registers() const
+    {
+        if (is_register()) {
+            return register_bit(text);
+        }
+        if (!is_memory()) {
+            return 0;
+        }
+        uint32_t bits = 0;
+        size_t start = text.find('[');
+        while (start < text.length()) {
+            while (start < text.length() && !std::isalnum(text[start])) {
+                start++;
+            }
+            size_t end = start;
+            while (end < text.length() && std::isalnum(text[end])) {
+                end++;
+            }
+            bits |= register_bit(std::string_view(text).substr(start, end - start));
+            start = end;
+        }
+        return bits;
+    }
+
+    bool operator==(const Operand& other) const
+    {
+        return kind == other.kind && text == other.text;
+    }
+};
+
+struct Instruction {
+    std::string opcode;
+    std::vector<Operand> operands;
+    std::string comment;
+};
+
+struct Line {
+    enum class Kind {
+        Instruction,
+        Label,
+        Comment,
+        // verbatim assembler text: directives, data, hand written runtime code
+        Raw,
+    };
+
+    Kind kind;
+    Instruction instruction;
+    std::string text;
+};
+
+class Code {
+public:
+    void emit(
+        const std::string_view opcode,
+        const std::initializer_list<std::string_view> operands = {},
+        const std::string_view comment = {})
+    {
+        Instruction instruction { .opcode = std::string(opcode), .comment = std::string(comment) };
+        for (const std::string_view operand : operands) {
+            instruction.operands.push_back(Operand::parse(operand));
+        }
+        m_lines.push_back({ .kind = Line::Kind::Instruction, .instruction = std::move(instruction) });
+    }
+
+    void label(const std::string_view name)
+    {
+        m_lines.push_back({ .kind = Line::Kind::Label, .text = std::string(name) });
+    }
+
+    void comment(const std::string_view text)
+    {
+        m_lines.push_back({ .kind = Line::Kind::Comment, .text = std::string(text) });
+    }
+
+    void raw(const std::string_view text)
+    {
+        m_lines.push_back({ .kind = Line::Kind::Raw, .text = std::string(text) });
+    }
+
+    std::vector<Line>& lines()
+    {
+        return m_lines;
+    }
+
+    [[nodiscard]] const std::vector<Line>& lines() const
+    {
+        return m_lines;
+    }
+
+    [[nodiscard]] size_t instruction_count() const
+    {
+        size_t count = 0;
+        for (const Line& line : m_lines) {
+            count += line.kind == Line::Kind::Instruction;
+        }
+        return count;
+    }
+
+    [[nodiscard]] std::string render() const
+    {
+        std::string out;
+        for (const Line& line : m_lines) {
+            switch (line.kind) {
+            case Line::Kind::Instruction:
+                out += "    " + line.instruction.opcode;
+                for (size_t i = 0; i < line.instruction.operands.size(); i++) {
+                    out += (i == 0 ? " " : ", ") + line.instruction.operands[i].text;
+                }
+                if (!line.instruction.comment.empty()) {
+                    out += " ; " + line.instruction.comment;
+                }
+                out += "\n";
+                break;
+            case Line::Kind::Label:
+                out += line.text + ":\n";
+                break;
+            case Line::Kind::Comment:
+                out += "    ; " + line.text + "\n";
+                break;
+            case Line::Kind::Raw:
+                out += line.text;
+                break;
+            }
+        }
+        return out;
+    }
+
+private:
+    std::vector<Line> m_lines {};
+};
+
+}
@@ -0,0 +1,176 @@
+// Checks the runtime's _itoa and _itoa_signed against std::to_chars. RuntimeHelper is encoded and loaded in memory
+// like `helium run` does, with a trampoline per routine so they can be called as C functions.
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../src/assembly.hpp"
+#include "../src/encoder.hpp"
+#include "../src/jit.hpp"
+
+namespace {
+
+// rdi is the number and rsi where the length goes, the digits' address comes back in rax. rbx is the only register
+// the routines clobber that the caller expects kept.
+const std::string Trampolines = R"(
+section .text
+itoa_unsigned:
+    push rbx
+    push rsi
+    mov rax, rdi
+    call _itoa
+    pop rsi
+    mov [rsi], rdx
+    pop rbx
+    ret
+itoa_signed:
+    push rbx
+    push rsi
+    mov rax, rdi
+    call _itoa_signed
+    pop rsi
+    mov [rsi], rdx
+    pop rbx
+    ret
+)";
+
+using Convert = const char* (*)(uint64_t value, uint64_t* length);
+
+class Checker {
+public:
+    Checker(const Convert unsigned_, const Convert signed_)
+        : m_unsigned(unsigned_)
+        , m_signed(signed_)
+    {
+    }
+
+    void check(const uint64_t value)
+    {
+        uint64_t length = 0;
+        const char* digits = m_unsigned(value, &length);
+        compare("_itoa", value, std::string_view(digits, length));
+    }
+
+    void check_signed(const int64_t value)
+    {
+        uint64_t length = 0;
+        const char* digits = m_signed(static_cast<uint64_t>(value), &length);
+        compare("_itoa_signed", value, std::string_view(digits, length));
+    }
+
+    [[nodiscard]] size_t checked() const
+    {
+        return m_checked;
+    }
+
+    [[nodiscard]] size_t failed() const
+    {
+        return m_failed;
+    }
+
+private:
+    template <typename T>
+    void compare(const std::string_view routine, const T value, const std::string_view got)
+    {
+        std::array<char, 24> expected {};
+        const auto result = std::to_chars(expected.begin(), expected.end(), value);
+        const std::string_view want(expected.data(), result.ptr - expected.data());
+        m_checked++;
+        if (got == want) {
+            return;
+        }
+        // the first few are enough to go on
+        if (m_failed++ < 10) {
+            std::cerr << routine << "(" << want << ") gave \"" << got << "\"" << std::endl;
+        }
+    }
+
+    Convert m_unsigned;
+    Convert m_signed;
+    size_t m_checked = 0;
+    size_t m_failed = 0;
+};
+
+}
+
+int main()
+{
+    X86::Code code;
+    code.raw(RuntimeHelper + Trampolines);
+    X86::Encoder encoder;
+    X86::Object object = encoder.encode(code);
+    std::vector<std::string> problems = encoder.problems();
+    Jit::Image image;
+    if (problems.empty()) {
+        problems = Jit::load(object, image);
+    }
+    const auto itoa_unsigned = X86::address(object, image.layout, "itoa_unsigned");
+    const auto itoa_signed = X86::address(object, image.layout, "itoa_signed");
+    if (problems.empty() && (!itoa_unsigned.has_value() || !itoa_signed.has_value())) {
+        problems.emplace_back("the trampolines are missing");
+    }
+    for (const std::string& problem : problems) {
+        std::cerr << "cannot load the runtime, " << problem << std::endl;
+    }
+    if (!problems.empty()) {
+        return EXIT_FAILURE;
+    }
+    Checker checker(
+        reinterpret_cast<Convert>(itoa_unsigned.value()), reinterpret_cast<Convert>(itoa_signed.value()));
+
+    // every number up to seven digits, either sign
+    for (int64_t value = 0; value < 10'000'000; value++) {
+        checker.check(static_cast<uint64_t>(value));
+        checker.check_signed(value);
+        checker.check_signed(-value);
+    }
+
+    constexpr uint64_t Max = std::numeric_limits<uint64_t>::max();
+    constexpr int64_t SignedMin = std::numeric_limits<int64_t>::min();
+    constexpr int64_t SignedMax = std::numeric_limits<int64_t>::max();
+
+    // around every power of ten, where the digit count changes
+    for (uint64_t power = 1;; power *= 10) {
+        for (uint64_t value = power - std::min<uint64_t>(power, 3); value <= power + 3; value++) {
+            checker.check(value);
+            if (value <= static_cast<uint64_t>(SignedMax)) {
+                checker.check_signed(static_cast<int64_t>(value));
+                checker.check_signed(-static_cast<int64_t>(value));
+            }
+        }
+        if (power > Max / 10) {
+            break;
+        }
+    }
+
+    for (uint64_t offset = 0; offset < 4; offset++) {
+        checker.check(Max - offset);
+        checker.check(static_cast<uint64_t>(SignedMax) - offset);
+        checker.check(static_cast<uint64_t>(SignedMax) + 1 + offset);
+        checker.check_signed(SignedMin + static_cast<int64_t>(offset));
+        checker.check_signed(SignedMax - static_cast<int64_t>(offset));
+    }
+
+    // shifting keeps every length about as likely as every other
+    std::mt19937_64 random(18);
+    for (int i = 0; i < 1'000'000; i++) {
+        const uint64_t value = random() >> (random() % 64);
+        checker.check(value);
+        checker.check_signed(static_cast<int64_t>(value));
+        checker.check_signed(static_cast<int64_t>(random()));
+    }
+
+    if (checker.failed() > 0) {
+        std::cerr << checker.failed() << " of " << checker.checked() << " conversions were wrong" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << checker.checked() << " conversions match std::to_chars" << std::endl;
+    return EXIT_SUCCESS;
+}